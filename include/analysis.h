@@ -0,0 +1,153 @@
+#ifndef _ANALYSIS_H_
+#define _ANALYSIS_H_
+
+#include "ast.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace scriptlang::analysis {
+
+using namespace ast;
+
+enum class InlineVerdict {
+    Inlinable,
+    Redeclared,
+    Reassigned,
+    NotSingleReturn,
+    Recursive,
+    TooLarge
+};
+
+struct FunctionInfo {
+    const FunctionDeclaration* declaration = nullptr;
+
+    // Expression of the single `return` statement, nullptr for `return;`.
+    const Expression* body = nullptr;
+
+    int size = 0;
+    bool hasAssignments = false;
+
+    InlineVerdict verdict = InlineVerdict::Inlinable;
+
+    // Never prints nor assigns a global, and only reads constant globals
+    // declared before it and other pure functions. Calls with constant
+    // arguments always produce the same result and may run at compile time.
+    bool pure = false;
+};
+
+struct GlobalInfo {
+    // Index of the first top-level statement that declares the global.
+    int declaredAt = -1;
+    int declarations = 0;
+    bool assigned = false;
+
+    const FunctionDeclaration* function = nullptr;
+    const Expression* initializer = nullptr;
+
+    // Set when every declaration carries the same annotation, assignments
+    // anywhere in the program are then checked against it.
+    TypeAnnotation annotation = TypeAnnotation::None;
+
+    // Read or assigned in the body of some function.
+    bool captured = false;
+
+    // A single `let` never assigned whose initializer only has literals,
+    // reads after the declaration may use its value directly.
+    bool constant = false;
+
+    // A single `let` no function refers to, among the first
+    // MAX_PROMOTED_GLOBALS of them. The script keeps it in a slot of its
+    // own frame rather than in the globals table.
+    bool promotable = false;
+};
+
+// Whole-script facts collected before compilation. Only meaningful when
+// the compiler sees the entire program at once (not in the REPL).
+class ProgramAnalysis final : private AstVisitor<ProgramAnalysis> {
+    friend class AstVisitor<ProgramAnalysis>;
+
+public:
+    static constexpr int INLINE_BUDGET = 24;
+
+    // Globals kept in the script's frame, its first slot holds the script.
+    static constexpr int MAX_PROMOTED_GLOBALS = 127;
+
+    // Nothing is assumed about the names in `outside`, code compiled
+    // before the program may declare, read or assign them.
+    explicit ProgramAnalysis(const StatementList& program,
+                             const std::unordered_set<std::string_view>* outside = nullptr);
+
+    auto global(std::string_view name) const -> const GlobalInfo*;
+    auto function(std::string_view name) const -> const FunctionInfo*;
+
+private:
+    auto analyzeFunction(const FunctionDeclaration& decl) -> void;
+    auto analyzePurity() -> void;
+    auto capture(std::string_view name) -> void;
+    auto isLocal(std::string_view name) const -> bool;
+
+    auto visitVariableDeclaration(const VariableDeclaration& decl) -> void;
+    auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void;
+
+    auto visitBlock(const Block& block) -> void;
+    auto visitWhileStatement(const WhileStatement& stmt) -> void;
+    auto visitForStatement(const ForStatement& stmt) -> void;
+    auto visitIfStatement(const IfStatement& stmt) -> void;
+    auto visitMatchStatement(const MatchStatement& stmt) -> void;
+    auto visitExpressionStatement(const ExpressionStatement& stmt) -> void;
+    auto visitContinueStatement(const ContinueStatement& stmt) -> void;
+    auto visitBreakStatement(const BreakStatement& stmt) -> void;
+    auto visitReturnStatement(const ReturnStatement& stmt) -> void;
+    auto visitPrintStatement(const PrintStatement& stmt) -> void;
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void;
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void;
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void;
+    auto visitCallExpression(const CallExpression& expr) -> void;
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void;
+    auto visitVariableExpression(const VariableExpression& expr) -> void;
+    auto visitLiteralExpression(const LiteralExpression& expr) -> void;
+
+private:
+    std::unordered_map<std::string_view, GlobalInfo> globals_;
+    std::unordered_map<std::string_view, FunctionInfo> functions_;
+
+    // Locals in scope while scanning a function body.
+    std::vector<std::string_view> locals_;
+    bool inFunction_ = false;
+
+    // Globals each function reads, and the functions that print or assign
+    // a global, for the purity analysis.
+    std::unordered_map<std::string_view, std::vector<std::string_view>> reads_;
+    std::unordered_set<std::string_view> effects_;
+    std::string_view function_;
+};
+
+struct ExpressionSummary {
+    int size = 0;
+    bool hasAssignments = false;
+    bool hasCalls = false;
+    bool hasNames = false;
+};
+
+auto summarize(const Expression& expr) -> ExpressionSummary;
+auto references(const Expression& expr, std::string_view name) -> bool;
+
+struct LoopSummary {
+    // Names assigned or declared anywhere in the loop, every other name
+    // holds the same value in all iterations.
+    std::unordered_set<std::string_view> written;
+
+    // Top-level expressions of the loop in evaluation order, the loop
+    // condition first.
+    std::vector<const Expression*> roots;
+};
+
+auto summarizeLoop(const WhileStatement& stmt) -> LoopSummary;
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace scriptlang::utils {
+
+// A fixed array allocated in an Arena.
+template<typename T>
+class ArenaArray final {
+public:
+    constexpr ArenaArray() = default;
+    constexpr ArenaArray(const T* data, std::size_t size)
+        : data_(data), size_(size) {}
+
+    constexpr auto begin() const -> const T* {
+        return data_;
+    }
+
+    constexpr auto end() const -> const T* {
+        return data_ + size_;
+    }
+
+    constexpr auto size() const -> std::size_t {
+        return size_;
+    }
+
+    constexpr auto empty() const -> bool {
+        return size_ == 0;
+    }
+
+    constexpr auto operator[](std::size_t index) const -> const T& {
+        return data_[index];
+    }
+
+    constexpr auto front() const -> const T& {
+        return data_[0];
+    }
+
+    constexpr auto back() const -> const T& {
+        return data_[size_ - 1];
+    }
+
+private:
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Bump allocator, objects are placed one after the other in large blocks
+// and all released together with the arena. Destructors never run, only
+// trivially destructible types can be allocated. Blocks double in size from
+// FIRST_BLOCK_SIZE, the arena of a single declaration stays small.
+class Arena final {
+
+    static constexpr std::size_t FIRST_BLOCK_SIZE = 1024;
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+public:
+    Arena() = default;
+
+    Arena(const Arena&) = delete;
+    auto operator=(const Arena&) -> Arena& = delete;
+
+    template<typename T, typename... Args>
+    inline auto make(Args&&... args) -> T* {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed.");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    inline auto copy(const std::vector<T>& items) -> ArenaArray<T> {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed.");
+
+        if(items.empty()) return {};
+
+        T* data = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+        std::uninitialized_copy(items.begin(), items.end(), data);
+
+        return ArenaArray<T>(data, items.size());
+    }
+
+    // Takes over the blocks of `other`, its objects are then released with
+    // this arena.
+    auto adopt(Arena& other) -> void;
+
+    // Bytes taken by the blocks.
+    inline auto capacity() const -> std::size_t {
+        return capacity_;
+    }
+
+private:
+    auto allocate(std::size_t size, std::size_t alignment) -> void*;
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* next_ = nullptr;
+    std::byte* end_ = nullptr;
+    std::size_t capacity_ = 0;
+};
+
+}
+
+#endif
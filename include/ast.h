@@ -1,9 +1,11 @@
 #ifndef _AST_H_
 #define _AST_H_
 
+#include "arena.h"
 #include "token.h"
 #include "source_position.h"
 
+#include <cstddef>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -15,13 +17,19 @@
 namespace scriptlang::ast {
 
 using namespace lexer;
+using utils::Arena;
+using utils::ArenaArray;
 
 // Forward
+class Expression;
+class Statement;
 class VariableDeclaration;
 class FunctionDeclaration;
 class Block;
 class WhileStatement;
+class ForStatement;
 class IfStatement;
+class MatchStatement;
 class ExpressionStatement;
 class ContinueStatement;
 class BreakStatement;
@@ -35,40 +43,56 @@ class GroupingExpression;
 class VariableExpression;
 class LiteralExpression;
 
+// Tag of every node, the visitors and instanceof switch on it instead of
+// going through virtual calls.
+enum class NodeKind : std::uint8_t {
+    VariableDeclaration,
+    FunctionDeclaration,
+    Block,
+    WhileStatement,
+    ForStatement,
+    IfStatement,
+    MatchStatement,
+    ExpressionStatement,
+    ContinueStatement,
+    BreakStatement,
+    ReturnStatement,
+    PrintStatement,
+
+    AssignmentExpression,
+    BinaryExpression,
+    UnaryExpression,
+    CallExpression,
+    GroupingExpression,
+    VariableExpression,
+    LiteralExpression
+};
+
+// Derived implements a visit method for every node and, when they are
+// private, befriends its AstVisitor. accept() dispatches to them with a
+// switch on the kind of the node, the calls resolve at compile time.
+template<typename Derived>
 class AstVisitor {
 public:
-    AstVisitor() = default;
-    virtual ~AstVisitor() = default;
-    
-    virtual auto visitVariableDeclaration(const VariableDeclaration& decl) -> void = 0;
-    virtual auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void = 0;
-
-    virtual auto visitBlock(const Block& block) -> void = 0;
-    virtual auto visitWhileStatement(const WhileStatement& stmt) -> void = 0;
-    virtual auto visitIfStatement(const IfStatement& stmt) -> void = 0;
-    virtual auto visitExpressionStatement(const ExpressionStatement& stmt) -> void = 0;
-    virtual auto visitContinueStatement(const ContinueStatement& stmt) -> void = 0;
-    virtual auto visitBreakStatement(const BreakStatement& stmt) -> void = 0;
-    virtual auto visitReturnStatement(const ReturnStatement& stmt) -> void = 0;
-    virtual auto visitPrintStatement(const PrintStatement& stmt) -> void = 0;
-
-    virtual auto visitAssignmentExpression(const AssignmentExpression& expr) -> void = 0;
-    virtual auto visitBinaryExpression(const BinaryExpression& expr) -> void = 0;
-    virtual auto visitUnaryExpression(const UnaryExpression& expr) -> void = 0;
-    virtual auto visitCallExpression(const CallExpression& expr) -> void = 0;
-    virtual auto visitGroupingExpression(const GroupingExpression& expr) -> void = 0;
-    virtual auto visitVariableExpression(const VariableExpression& expr) -> void = 0;
-    virtual auto visitLiteralExpression(const LiteralExpression& expr) -> void = 0;
+    static auto dispatch(Derived& visitor, const Statement& stmt) -> void;
+    static auto dispatch(Derived& visitor, const Expression& expr) -> void;
 };
 
+// Nodes live in the Arena of their Program and are never destroyed one by
+// one, they have no virtual methods at all.
 class Expression {
 public:
-    constexpr Expression(SourceRange location)
-        : location_(location) {}
+    constexpr Expression(NodeKind kind, SourceRange location)
+        : location_(location), kind_(kind) {}
 
-    virtual ~Expression() = default;
+    template<typename Visitor>
+    inline auto accept(Visitor& visitor) const -> void {
+        AstVisitor<Visitor>::dispatch(visitor, *this);
+    }
 
-    virtual auto accept(AstVisitor& visitor) -> void = 0;
+    constexpr auto kind() const -> NodeKind {
+        return kind_;
+    }
 
     inline auto location() const -> SourceRange {
         return location_;
@@ -76,16 +100,22 @@ public:
 
 private:
     SourceRange location_;
+    NodeKind kind_;
 };
 
 class Statement {
 public:
-    constexpr Statement(SourceRange location)
-        : location_(location) {}
+    constexpr Statement(NodeKind kind, SourceRange location)
+        : location_(location), kind_(kind) {}
 
-    virtual ~Statement() = default;
+    template<typename Visitor>
+    inline auto accept(Visitor& visitor) const -> void {
+        AstVisitor<Visitor>::dispatch(visitor, *this);
+    }
 
-    virtual auto accept(AstVisitor& visitor) -> void = 0;
+    constexpr auto kind() const -> NodeKind {
+        return kind_;
+    }
 
     inline auto location() const -> SourceRange {
         return location_;
@@ -93,105 +123,195 @@ public:
 
 private:
     SourceRange location_;
+    NodeKind kind_;
 };
 
-using ExpressionPtr = std::unique_ptr<Expression>;
-using StatementPtr = std::unique_ptr<Statement>;
+// Optional type of a variable or parameter, `let total: num = 0;`.
+enum class TypeAnnotation : std::uint8_t {
+    None,
+    Number,
+    String,
+    Boolean
+};
+
+constexpr auto typeName(TypeAnnotation type) -> const char* {
+    switch(type){
+        case TypeAnnotation::Number: return "num";
+        case TypeAnnotation::String: return "str";
+        case TypeAnnotation::Boolean: return "bool";
+        default: return "any";
+    }
+}
+
+// Pointer to a node in the arena, which owns it.
+template<typename T>
+class NodePtr final {
+public:
+    constexpr NodePtr() = default;
+    constexpr NodePtr(std::nullptr_t) {}
+    constexpr explicit NodePtr(T* node) : node_(node) {}
+
+    constexpr auto get() const -> T* {
+        return node_;
+    }
+
+    constexpr auto operator->() const -> T* {
+        return node_;
+    }
+
+    constexpr auto operator*() const -> T& {
+        return *node_;
+    }
+
+    constexpr explicit operator bool() const {
+        return node_ != nullptr;
+    }
+
+    constexpr auto operator==(std::nullptr_t) const -> bool {
+        return node_ == nullptr;
+    }
+
+    constexpr auto operator!=(std::nullptr_t) const -> bool {
+        return node_ != nullptr;
+    }
+
+private:
+    T* node_ = nullptr;
+};
+
+using ExpressionPtr = NodePtr<Expression>;
+using StatementPtr = NodePtr<Statement>;
+
+using ExpressionList = ArenaArray<ExpressionPtr>;
+using StatementList = ArenaArray<StatementPtr>;
 
 template<typename T, typename... Args,
          typename = std::enable_if_t<std::is_base_of_v<Statement, T>>>
-inline auto makeStatement(Args&&... args) -> StatementPtr {
-    return std::make_unique<T>(std::forward<Args>(args)...);
+inline auto makeStatement(Arena& arena, Args&&... args) -> StatementPtr {
+    return StatementPtr(arena.make<T>(std::forward<Args>(args)...));
 }
 
 template<typename T, typename... Args,
          typename = std::enable_if_t<std::is_base_of_v<Expression, T>>>
-inline auto makeExpression(Args&&... args) -> ExpressionPtr {
-    return std::make_unique<T>(std::forward<Args>(args)...);
+inline auto makeExpression(Arena& arena, Args&&... args) -> ExpressionPtr {
+    return ExpressionPtr(arena.make<T>(std::forward<Args>(args)...));
 }
 
+// A parsed source, its nodes are freed in one go with the arena.
+struct Program {
+    std::unique_ptr<Arena> arena;
+    StatementList statements;
+};
+
 // Statements
 
 class VariableDeclaration : public Statement {
 public:
-    VariableDeclaration(SourceRange location ,Token name, ExpressionPtr& initializer)
-        : Statement(location),
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::VariableDeclaration;
+    }
+
+    VariableDeclaration(SourceRange location ,Token name, ExpressionPtr& initializer,
+                        TypeAnnotation annotation = TypeAnnotation::None)
+        : Statement(NodeKind::VariableDeclaration, location),
           name_(std::move(name)), 
-          initializer_(std::move(initializer)) {}
+          initializer_(std::move(initializer)),
+          annotation_(annotation) {}
 
     inline auto name() const -> const Token& {
         return name_;
     }
 
-    inline auto initializer() const -> const ExpressionPtr& {
-        return initializer_;
+    inline auto annotation() const -> TypeAnnotation {
+        return annotation_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitVariableDeclaration(*this);
+    inline auto initializer() const -> const ExpressionPtr& {
+        return initializer_;
     }
 
 private:
     Token name_;
     ExpressionPtr initializer_;
+    TypeAnnotation annotation_;
 };
 
 class FunctionDeclaration : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::FunctionDeclaration;
+    }
+
     FunctionDeclaration(SourceRange location,
                         Token name, 
-                        std::vector<Token>& params,
-                        StatementPtr& body)
-        : Statement(location),
+                        ArenaArray<Token> params,
+                        ArenaArray<TypeAnnotation> annotations,
+                        StatementPtr& body,
+                        bool memoized = false)
+        : Statement(NodeKind::FunctionDeclaration, location),
           name_(std::move(name)),
           body_(std::move(body)),
-          parameters_(std::move(params)) {}
+          parameters_(params),
+          annotations_(annotations),
+          memoized_(memoized) {}
 
     inline auto name() const -> const Token& {
         return name_;
     }
 
-    inline auto params() const -> const std::vector<Token>& {
+    inline auto params() const -> const ArenaArray<Token>& {
         return parameters_;
     }
 
+    // One entry per parameter.
+    inline auto annotations() const -> const ArenaArray<TypeAnnotation>& {
+        return annotations_;
+    }
+
     inline auto body() const -> const StatementPtr& {
         return body_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitFunctionDeclaration(*this);
+    // Declared `@memo`, results are cached by argument values.
+    inline auto memoized() const -> bool {
+        return memoized_;
     }
 
 private:
     Token name_;
     StatementPtr body_;
-    std::vector<Token> parameters_;
+    ArenaArray<Token> parameters_;
+    ArenaArray<TypeAnnotation> annotations_;
+    bool memoized_;
 };
 
 class Block : public Statement {
 public:
-    Block(SourceRange location, std::vector<StatementPtr>& stmts)
-        : Statement(location), statements_(std::move(stmts)) {} 
-    
-    auto statements() const -> const std::vector<StatementPtr>& {
-        return statements_;
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::Block;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitBlock(*this);
+    Block(SourceRange location, StatementList stmts)
+        : Statement(NodeKind::Block, location), statements_(stmts) {} 
+    
+    auto statements() const -> const StatementList& {
+        return statements_;
     }
 
 private:
-    std::vector<StatementPtr> statements_;
+    StatementList statements_;
 };
 
 class WhileStatement : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::WhileStatement;
+    }
+
     WhileStatement(SourceRange location,
                 ExpressionPtr& condition,
                 StatementPtr& body)
-        : Statement(location),
+        : Statement(NodeKind::WhileStatement, location),
           condition_(std::move(condition)),
           body_(std::move(body)) {}
 
@@ -203,22 +323,75 @@ public:
         return body_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitWhileStatement(*this);
+private:
+    ExpressionPtr condition_;
+    StatementPtr body_;
+};
+
+// Counted loop `for i = start, limit, step { }`. The bounds and the step are
+// evaluated once, the limit is inclusive and the step defaults to 1.
+class ForStatement : public Statement {
+public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::ForStatement;
+    }
+
+    ForStatement(SourceRange location,
+                Token variable,
+                ExpressionPtr& start,
+                ExpressionPtr& limit,
+                ExpressionPtr& step,
+                StatementPtr& body)
+        : Statement(NodeKind::ForStatement, location),
+          variable_(std::move(variable)),
+          start_(std::move(start)),
+          limit_(std::move(limit)),
+          step_(std::move(step)),
+          body_(std::move(body)) {}
+
+    inline auto variable() const -> const Token& {
+        return variable_;
+    }
+
+    inline auto start() const -> const ExpressionPtr& {
+        return start_;
+    }
+
+    inline auto limit() const -> const ExpressionPtr& {
+        return limit_;
+    }
+
+    inline auto step() const -> const ExpressionPtr& {
+        return step_;
+    }
+
+    auto haveStep() const -> bool {
+        return step_ != nullptr;
+    }
+
+    inline auto body() const -> const StatementPtr& {
+        return body_;
     }
 
 private:
-    ExpressionPtr condition_;
+    Token variable_;
+    ExpressionPtr start_;
+    ExpressionPtr limit_;
+    ExpressionPtr step_;
     StatementPtr body_;
 };
 
 class IfStatement : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::IfStatement;
+    }
+
     IfStatement(SourceRange location,
                 ExpressionPtr& condition,
                 StatementPtr& thenBranch,
                 StatementPtr& elseBranch)
-        : Statement(location),
+        : Statement(NodeKind::IfStatement, location),
           condition_(std::move(condition)),
           thenBranch_(std::move(thenBranch)),
           elseBranch_(std::move(elseBranch)) {}
@@ -239,57 +412,101 @@ public:
         return elseBranch_ != nullptr;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitIfStatement(*this);
-    }
-
 private:
     ExpressionPtr condition_;
     StatementPtr thenBranch_;
     StatementPtr elseBranch_;
 };
 
+// Arm of a `match`, taken when the subject equals one of the labels.
+// Labels are integer or string literals.
+struct MatchArm {
+    ExpressionList labels;
+    StatementPtr body;
+};
+
+class MatchStatement : public Statement {
+public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::MatchStatement;
+    }
+
+    MatchStatement(SourceRange location,
+                   ExpressionPtr& subject,
+                   ArenaArray<MatchArm> arms,
+                   StatementPtr& elseBranch)
+        : Statement(NodeKind::MatchStatement, location),
+          subject_(std::move(subject)),
+          arms_(arms),
+          elseBranch_(std::move(elseBranch)) {}
+
+    inline auto subject() const -> const ExpressionPtr& {
+        return subject_;
+    }
+
+    inline auto arms() const -> const ArenaArray<MatchArm>& {
+        return arms_;
+    }
+
+    inline auto elseBranch() const -> const StatementPtr& {
+        return elseBranch_;
+    }
+
+    auto haveElseBranch() const -> bool {
+        return elseBranch_ != nullptr;
+    }
+
+private:
+    ExpressionPtr subject_;
+    ArenaArray<MatchArm> arms_;
+    StatementPtr elseBranch_;
+};
+
 class ExpressionStatement : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::ExpressionStatement;
+    }
+
     ExpressionStatement(SourceRange location, ExpressionPtr& expr)
-        : Statement(location), expression_(std::move(expr)) {} ;
+        : Statement(NodeKind::ExpressionStatement, location), expression_(std::move(expr)) {} ;
 
     inline auto expression() const -> const ExpressionPtr& {
         return expression_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitExpressionStatement(*this);
-    }
-
 private:
     ExpressionPtr expression_;
 };
 
 class ContinueStatement : public Statement {
 public:
-    ContinueStatement(SourceRange location)
-        : Statement(location) {};
-
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitContinueStatement(*this);
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::ContinueStatement;
     }
+
+    ContinueStatement(SourceRange location)
+        : Statement(NodeKind::ContinueStatement, location) {};
 };
 
 class BreakStatement : public Statement {
 public:
-    BreakStatement(SourceRange location)
-        : Statement(location) {} ;
-
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitBreakStatement(*this);
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::BreakStatement;
     }
+
+    BreakStatement(SourceRange location)
+        : Statement(NodeKind::BreakStatement, location) {} ;
 };
 
 class ReturnStatement : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::ReturnStatement;
+    }
+
     ReturnStatement(SourceRange location, ExpressionPtr& expr)
-        : Statement(location), expression_(std::move(expr)) {} ;
+        : Statement(NodeKind::ReturnStatement, location), expression_(std::move(expr)) {} ;
 
     inline auto expression() const -> const ExpressionPtr& {
         return expression_;
@@ -299,18 +516,18 @@ public:
         return expression_ != nullptr;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitReturnStatement(*this);
-    }
-
 private:
     ExpressionPtr expression_;
 };
 
 class PrintStatement : public Statement {
 public:
+    static constexpr auto classof(const Statement* node) -> bool {
+        return node->kind() == NodeKind::PrintStatement;
+    }
+
     PrintStatement(SourceRange location, ExpressionPtr& expr)
-        : Statement(location), expression_(std::move(expr)) {} ;
+        : Statement(NodeKind::PrintStatement, location), expression_(std::move(expr)) {} ;
 
     inline auto expression() const -> const ExpressionPtr& {
         return expression_;
@@ -320,10 +537,6 @@ public:
         return expression_ != nullptr;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitPrintStatement(*this);
-    }
-
 private:
     ExpressionPtr expression_;
 };
@@ -332,10 +545,14 @@ private:
 
 class AssignmentExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::AssignmentExpression;
+    }
+
     AssignmentExpression(SourceRange location, 
                          Token name,
                          ExpressionPtr& value)
-        : Expression(location),
+        : Expression(NodeKind::AssignmentExpression, location),
           name_(std::move(name)),
           value_(std::move(value)) {}
 
@@ -348,10 +565,6 @@ public:
         return value_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitAssignmentExpression(*this);
-    }
-
 private:
     Token name_;
     ExpressionPtr value_;
@@ -359,11 +572,15 @@ private:
 
 class BinaryExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::BinaryExpression;
+    }
+
     BinaryExpression(SourceRange location,
                      Token op, 
                      ExpressionPtr& left, 
                      ExpressionPtr& right)
-        : Expression(location),
+        : Expression(NodeKind::BinaryExpression, location),
           operator_(std::move(op)),
           left_(std::move(left)),
           right_(std::move(right)) {}
@@ -380,10 +597,6 @@ public:
         return left_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitBinaryExpression(*this);
-    }
-
 private:
     Token operator_;
     ExpressionPtr left_;
@@ -392,8 +605,12 @@ private:
 
 class UnaryExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::UnaryExpression;
+    }
+
     UnaryExpression(SourceRange location, Token op, ExpressionPtr& expression)
-        : Expression(location),
+        : Expression(NodeKind::UnaryExpression, location),
           operator_(std::move(op)),
           right_(std::move(expression)) {}
           
@@ -405,10 +622,6 @@ public:
         return right_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitUnaryExpression(*this);
-    }
-
 private:
     Token operator_;
     ExpressionPtr right_;
@@ -416,63 +629,63 @@ private:
 
 class CallExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::CallExpression;
+    }
+
     CallExpression(SourceRange location, 
                    ExpressionPtr& callee, 
-                   std::vector<ExpressionPtr>& args)
-        : Expression(location),
+                   ExpressionList args)
+        : Expression(NodeKind::CallExpression, location),
           callee_(std::move(callee)),
-          arguments_(std::move(args)) {}
+          arguments_(args) {}
 
 
     inline auto callee() const -> const ExpressionPtr& {
         return callee_;
     }
 
-    inline auto arguments() const -> const std::vector<ExpressionPtr>& {
+    inline auto arguments() const -> const ExpressionList& {
         return arguments_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitCallExpression(*this);
-    }
-
 private:
     ExpressionPtr callee_;
-    std::vector<ExpressionPtr> arguments_;
+    ExpressionList arguments_;
 };
 
 
 class GroupingExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::GroupingExpression;
+    }
+
     GroupingExpression(SourceRange location, ExpressionPtr& expression)
-        : Expression(location),
+        : Expression(NodeKind::GroupingExpression, location),
           expression_(std::move(expression)) {}
     
     inline auto expression() const -> const ExpressionPtr& {
         return expression_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitGroupingExpression(*this);
-    }
-
 private:
     ExpressionPtr expression_;
 };
 
 class VariableExpression : public Expression {
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::VariableExpression;
+    }
+
     VariableExpression(SourceRange location, Token name)
-        : Expression(location), name_(name) {}
+        : Expression(NodeKind::VariableExpression, location), name_(name) {}
 
     auto inline name() const -> Token {
         return name_;
     }
 
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitVariableExpression(*this);
-    }
-    
 private:
     Token name_;
 };
@@ -481,26 +694,37 @@ class LiteralExpression : public Expression {
     enum class LiteralType : std::uint8_t {
         String,
         Number,
+        Integer,
         Boolean,
         Nil
     };
 
 public:
+    static constexpr auto classof(const Expression* node) -> bool {
+        return node->kind() == NodeKind::LiteralExpression;
+    }
+
     constexpr LiteralExpression(SourceRange location)
-        : Expression(location) {}
+        : Expression(NodeKind::LiteralExpression, location) {}
 
     constexpr LiteralExpression(SourceRange location, double number)
-        : Expression(location),
+        : Expression(NodeKind::LiteralExpression, location),
           type_(LiteralType::Number),
           data_(number) { }
+
+    constexpr LiteralExpression(SourceRange location, std::int64_t integer)
+        : Expression(NodeKind::LiteralExpression, location),
+          type_(LiteralType::Integer),
+          data_(integer) { }
           
-    LiteralExpression(SourceRange location, std::string_view sv)
-        : Expression(location),
+    // The view stays in the source buffer, which outlives the tree.
+    constexpr LiteralExpression(SourceRange location, std::string_view sv)
+        : Expression(NodeKind::LiteralExpression, location),
           type_(LiteralType::String),
-          data_{std::string(sv)} {} 
+          data_(sv) {} 
 
     constexpr LiteralExpression(SourceRange location, bool boolean)
-        : Expression(location),
+        : Expression(NodeKind::LiteralExpression, location),
           type_(LiteralType::Boolean),
           data_(boolean) {}
 
@@ -512,8 +736,13 @@ public:
         return type_ == LiteralType::String;
     }
 
+    // Integers are numbers too, asNumber() converts them.
     constexpr auto isNumber() const -> bool {
-        return type_ == LiteralType::Number;
+        return type_ == LiteralType::Number || isInteger();
+    }
+
+    constexpr auto isInteger() const -> bool {
+        return type_ == LiteralType::Integer;
     }
 
     constexpr auto isNil() const -> bool {
@@ -524,32 +753,89 @@ public:
         return std::get<bool>(data_);
     }
 
-    constexpr auto asString() const -> const std::string& {
-        return std::get<std::string>(data_);
+    constexpr auto asString() const -> std::string_view {
+        return std::get<std::string_view>(data_);
     }
 
     constexpr auto asNumber() const -> double {
-        return std::get<double>(data_);
+        return isInteger()
+            ? static_cast<double>(std::get<std::int64_t>(data_))
+            : std::get<double>(data_);
     }
 
-
-    inline auto accept(AstVisitor& visitor) -> void {
-        visitor.visitLiteralExpression(*this);
+    constexpr auto asInteger() const -> std::int64_t {
+        return std::get<std::int64_t>(data_);
     }
 
 private:
     LiteralType type_ = LiteralType::Nil;
-    std::variant<std::monostate, double, bool, std::string> data_;
+    std::variant<std::monostate, double, std::int64_t, bool, std::string_view> data_;
 };
 
+template<typename Derived>
+inline auto AstVisitor<Derived>::dispatch(Derived& visitor, const Statement& stmt) -> void {
+    switch(stmt.kind()){
+        case NodeKind::VariableDeclaration:
+            return visitor.visitVariableDeclaration(static_cast<const VariableDeclaration&>(stmt));
+        case NodeKind::FunctionDeclaration:
+            return visitor.visitFunctionDeclaration(static_cast<const FunctionDeclaration&>(stmt));
+        case NodeKind::Block:
+            return visitor.visitBlock(static_cast<const Block&>(stmt));
+        case NodeKind::WhileStatement:
+            return visitor.visitWhileStatement(static_cast<const WhileStatement&>(stmt));
+        case NodeKind::ForStatement:
+            return visitor.visitForStatement(static_cast<const ForStatement&>(stmt));
+        case NodeKind::IfStatement:
+            return visitor.visitIfStatement(static_cast<const IfStatement&>(stmt));
+        case NodeKind::MatchStatement:
+            return visitor.visitMatchStatement(static_cast<const MatchStatement&>(stmt));
+        case NodeKind::ExpressionStatement:
+            return visitor.visitExpressionStatement(static_cast<const ExpressionStatement&>(stmt));
+        case NodeKind::ContinueStatement:
+            return visitor.visitContinueStatement(static_cast<const ContinueStatement&>(stmt));
+        case NodeKind::BreakStatement:
+            return visitor.visitBreakStatement(static_cast<const BreakStatement&>(stmt));
+        case NodeKind::ReturnStatement:
+            return visitor.visitReturnStatement(static_cast<const ReturnStatement&>(stmt));
+        case NodeKind::PrintStatement:
+            return visitor.visitPrintStatement(static_cast<const PrintStatement&>(stmt));
+        default:
+            return;
+    }
+}
+
+template<typename Derived>
+inline auto AstVisitor<Derived>::dispatch(Derived& visitor, const Expression& expr) -> void {
+    switch(expr.kind()){
+        case NodeKind::AssignmentExpression:
+            return visitor.visitAssignmentExpression(static_cast<const AssignmentExpression&>(expr));
+        case NodeKind::BinaryExpression:
+            return visitor.visitBinaryExpression(static_cast<const BinaryExpression&>(expr));
+        case NodeKind::UnaryExpression:
+            return visitor.visitUnaryExpression(static_cast<const UnaryExpression&>(expr));
+        case NodeKind::CallExpression:
+            return visitor.visitCallExpression(static_cast<const CallExpression&>(expr));
+        case NodeKind::GroupingExpression:
+            return visitor.visitGroupingExpression(static_cast<const GroupingExpression&>(expr));
+        case NodeKind::VariableExpression:
+            return visitor.visitVariableExpression(static_cast<const VariableExpression&>(expr));
+        case NodeKind::LiteralExpression:
+            return visitor.visitLiteralExpression(static_cast<const LiteralExpression&>(expr));
+        default:
+            return;
+    }
+}
+
 namespace printer {
 
-class AstPrettyPrinter : private AstVisitor {
+class AstPrettyPrinter : private AstVisitor<AstPrettyPrinter> {
+    friend class AstVisitor<AstPrettyPrinter>;
+
 public:
     explicit AstPrettyPrinter(std::ostream& stream, int indentSize = 4)
         : stream_(stream), indentSize_(indentSize) {}
 
-    auto print(const std::vector<StatementPtr>& program) -> void;
+    auto print(const StatementList& program) -> void;
 
 private:
     auto visitVariableDeclaration(const VariableDeclaration& decl) -> void;
@@ -557,7 +843,9 @@ private:
 
     auto visitBlock(const Block& block) -> void;
     auto visitWhileStatement(const WhileStatement& stmt) -> void;
+    auto visitForStatement(const ForStatement& stmt) -> void;
     auto visitIfStatement(const IfStatement& stmt) -> void;
+    auto visitMatchStatement(const MatchStatement& stmt) -> void;
     auto visitExpressionStatement(const ExpressionStatement& stmt) -> void;
     auto visitContinueStatement(const ContinueStatement& stmt) -> void;
     auto visitBreakStatement(const BreakStatement& stmt) -> void;
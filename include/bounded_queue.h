@@ -0,0 +1,72 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace scriptlang::utils {
+
+// Hands items from a producer thread to a consumer thread, push() waits
+// while `capacity` items are queued. Either side may close the queue: later
+// pushes fail, pops drain what is left and then return nullopt.
+template<typename T>
+class BoundedQueue final {
+public:
+    explicit BoundedQueue(std::size_t capacity)
+        : capacity_(capacity) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    auto operator=(const BoundedQueue&) -> BoundedQueue& = delete;
+
+    auto push(T item) -> bool {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this]{ return closed_ || items_.size() < capacity_; });
+
+        if(closed_) return false;
+
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+
+        return true;
+    }
+
+    auto pop() -> std::optional<T> {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this]{ return closed_ || !items_.empty(); });
+
+        if(items_.empty()) return std::nullopt;
+
+        std::optional<T> item(std::move(items_.front()));
+        items_.pop_front();
+        notFull_.notify_one();
+
+        return item;
+    }
+
+    auto close() -> void {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+
+    std::deque<T> items_;
+    std::size_t capacity_;
+    bool closed_ = false;
+};
+
+}
+
+#endif
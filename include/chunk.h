@@ -4,31 +4,62 @@
 #include "opcode.h"
 
 #include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace scriptlang::runtime {
 
-struct LineInfo {
-    std::uint32_t line;
+// The instructions from `offset` on come from the source at `position`,
+// a SourcePosition decoded by the SourceManager when an error is reported.
+struct PositionInfo {
+    std::uint32_t position;
     std::uint32_t offset;
 };
 
+// The instructions in [start, end) run the body of the function `name`,
+// inlined at a call site. Runtime errors list it as a frame of its own.
+struct InlinedCall {
+    std::uint32_t start;
+    std::uint32_t end;
+    std::string name;
+    int arity;
+};
+
 // Forward
 class Value;
 
+// Targets of a JumpTable instruction, as offsets from the end of the
+// instruction. Integer cases in a small range are indexed directly, other
+// integers and strings are hashed. Offset 0 falls through to the default.
+struct CaseTable {
+    std::int64_t low = 0;
+    std::vector<std::uint16_t> dense;
+
+    std::unordered_map<std::int64_t, std::uint16_t> integers;
+    std::unordered_map<std::string, std::uint16_t> strings;
+};
+
+// Source position of the `if` a conditional jump belongs to, only recorded
+// for profiling runs.
+struct BranchSite {
+    std::uint32_t line;
+    std::uint32_t column;
+};
+
 class Chunk {
 public:
     Chunk() = default;
 
-    inline auto write(OpCode code, std::uint32_t line) -> void {
-        write(static_cast<Byte>(code), line);
+    inline auto write(OpCode code, std::uint32_t position) -> void {
+        write(static_cast<Byte>(code), position);
     }
 
-    inline auto write(Byte byte, std::uint32_t line) -> void {
+    inline auto write(Byte byte, std::uint32_t position) -> void {
         code_.push_back(byte);
 
-        if(lines_.size() > 0 && lines_.back().line == line) return;
-        lines_.push_back({line, (std::uint32_t) code_.size() - 1});
+        if(positions_.size() > 0 && positions_.back().position == position) return;
+        positions_.push_back({position, (std::uint32_t) code_.size() - 1});
     }
 
     inline auto size() const -> std::size_t {
@@ -39,29 +70,69 @@ public:
         return code_[index];
     }
 
+    inline auto operator[](std::uint32_t index) const -> Byte {
+        return code_[index];
+    }
+
     template<typename... Args>
     inline auto addConstant(Args&&... args) -> std::uint8_t {
         constants_.emplace_back(std::forward<Args>(args)...);
         return constants_.size() - 1;
     }
 
-    inline auto getConstant(std::uint32_t index) -> const Value& {
+    inline auto getConstant(std::uint32_t index) const -> const Value& {
         return constants_[index];
     }
 
-    auto getLine(std::uint32_t instructionOffset) -> std::uint32_t {
+    inline auto constantsCount() const -> std::size_t {
+        return constants_.size();
+    }
+
+    inline auto addCaseTable(CaseTable table) -> std::size_t {
+        caseTables_.push_back(std::move(table));
+        return caseTables_.size() - 1;
+    }
+
+    inline auto getCaseTable(std::uint32_t index) -> CaseTable& {
+        return caseTables_[index];
+    }
+
+    inline auto getCaseTable(std::uint32_t index) const -> const CaseTable& {
+        return caseTables_[index];
+    }
+
+    inline auto addBranchSite(std::uint32_t offset, BranchSite site) -> void {
+        branchSites_[offset] = site;
+    }
+
+    inline auto getBranchSite(std::uint32_t offset) const -> const BranchSite* {
+        const auto it = branchSites_.find(offset);
+        return it != branchSites_.end() ? &it->second : nullptr;
+    }
+
+    inline auto addInlinedCall(InlinedCall call) -> void {
+        inlinedCalls_.push_back(std::move(call));
+    }
+
+    // A call is added once its body is compiled, the ones nested in it come
+    // first.
+    inline auto inlinedCalls() const -> const std::vector<InlinedCall>& {
+        return inlinedCalls_;
+    }
+
+    auto getPosition(std::uint32_t instructionOffset) const -> std::uint32_t {
 
         std::uint32_t start = 0;
-        std::uint32_t end = lines_.size() - 1;
+        std::uint32_t end = positions_.size() - 1;
         std::uint32_t mid;
 
         while(true){
             mid = (start + end) / 2;
 
-            if(instructionOffset < lines_[mid].offset){
+            if(instructionOffset < positions_[mid].offset){
                 end = mid - 1;
-            } else if(mid == lines_.size() - 1 || instructionOffset < lines_[mid+1].offset){
-                return lines_[mid].line;
+            } else if(mid == positions_.size() - 1 || instructionOffset < positions_[mid+1].offset){
+                return positions_[mid].position;
             } else {
                 start = mid + 1;
             }
@@ -70,8 +141,11 @@ public:
 
 private:
     std::vector<Value> constants_;
+    std::vector<CaseTable> caseTables_;
+    std::unordered_map<std::uint32_t, BranchSite> branchSites_;
     std::vector<Byte> code_;
-    std::vector<LineInfo> lines_;
+    std::vector<PositionInfo> positions_;
+    std::vector<InlinedCall> inlinedCalls_;
 };
 
 }
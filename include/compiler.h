@@ -2,13 +2,21 @@
 #define _COMPILER_H_
 
 #include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "analysis.h"
 #include "ast.h"
 #include "error_reporter.h"
 #include "objects.h"
+#include "source_manager.h"
+#include "type_inference.h"
 #include "types.h"
 #include "vm.h"
 
@@ -18,12 +26,49 @@ using namespace ast;
 using namespace runtime;
 using namespace error;
 using namespace types;
+using analysis::ProgramAnalysis;
+using analysis::FunctionInfo;
+using analysis::LoopSummary;
+using analysis::TypeInference;
+using lexer::SourceManager;
 
-class Compiler : private AstVisitor {
+struct CompilerOptions {
+    bool debugMode = false;
+
+    // Enables every optimization; when false the AST is compiled verbatim.
+    bool optimize = true;
+
+    // Print every inlining decision to stdout.
+    bool inlineReport = false;
+
+    // The compiler sees the whole program (false in the REPL, where later
+    // lines can redefine anything), enabling cross-function optimizations.
+    bool wholeProgram = true;
+
+    // The names in the statements that ran before the whole program, when
+    // it is the rest of a pipelined source.
+    const std::unordered_set<std::string_view>* outside = nullptr;
+
+    // Tag the conditional jump of every `if` with its source position, so
+    // a profiling run can record branch directions.
+    bool recordBranches = false;
+
+    // Counts of earlier runs guiding branch layout and inlining.
+    const Profile* profile = nullptr;
+
+    // Decodes the lines of the inline report and the positions of the
+    // branches in the profile.
+    const SourceManager* sources = nullptr;
+};
+
+class Compiler : private AstVisitor<Compiler> {
+    friend class AstVisitor<Compiler>;
 
     struct Local {
         Token name;
         int depth;
+
+        TypeAnnotation type;
     };
 
     struct Loop {
@@ -32,32 +77,93 @@ class Compiler : private AstVisitor {
         int scopeDepth;
         std::uint32_t start;
         std::uint32_t end;
+
+        // `continue` in a numeric `for` jumps forward to the ForLoop
+        // instruction, these jumps are patched once it is emitted.
+        bool counted = false;
+        std::vector<int> continues;
+    };
+
+    // Parameter of a function being inlined. It either lives in a stack
+    // slot of the caller's frame or is substituted by a trivial argument.
+    struct InlineBinding {
+        std::string_view name;
+        int slot;
+
+        const Expression* argument;
+        TypeAnnotation type;
+    };
+
+    struct InlineFrame {
+        InlineFrame* enclosing;
+
+        const FunctionDeclaration* function;
+        std::vector<InlineBinding> bindings;
+    };
+
+    // Pure expression over locals whose value currently sits in `slot`,
+    // either a temporary on the stack or a local it was assigned to.
+    struct AvailableExpression {
+        const Expression* expr;
+        int slot;
+        std::uint32_t id;
+
+        std::vector<int> reads;
     };
 
 public:
     static constexpr auto MAX_LOCALS = BYTE_MAX;
+    static constexpr std::uint64_t MAX_DENSE_CASES = 1024;
+    static constexpr int MAX_INLINE_DEPTH = 4;
+
+    // Functions called this many times in the profile are inlined up to
+    // the larger budget.
+    static constexpr std::uint64_t HOT_CALLS = 1000;
+    static constexpr int HOT_INLINE_BUDGET = 3 * ProgramAnalysis::INLINE_BUDGET;
+    static constexpr std::uint64_t EVALUATION_FUEL = 1'000'000;
+    static constexpr std::uint64_t EVALUATION_BUDGET = 10'000'000;
 
     enum class FunctionType {
         Function,
         Script
     };
 
-    Compiler(FunctionType type, ErrorReporter* reporter, bool debugMode = false)
+    Compiler(FunctionType type, ErrorReporter* reporter, CompilerOptions options = {})
         : type_(type),
           reporter_(reporter),
-          debugMode_(debugMode) {};
+          options_(options) {
+        // The slot of the callee, endScope() never pops it.
+        locals_[0] = Local { {}, 0, TypeAnnotation::None };
+    }
 
-    auto compile(const std::vector<StatementPtr>& ast) -> ObjectFunction;
+    auto compile(const StatementList& ast) -> ObjectFunction;
 
 private:
 
-    inline auto compileExpression(const ExpressionPtr& expr) -> void {
+    inline auto compileExpression(const Expression* expr) -> void {
         currentNodeLocation_ = expr->location();
-        expr->accept(*this);
+
+        if(!hoisted_.empty()){
+            const auto hoisted = hoisted_.find(expr);
+
+            if(hoisted != hoisted_.end()){
+                emit(OpCode::GetLocal);
+                emit(static_cast<Byte>(hoisted->second));
+                return;
+            }
+        }
+
+        const_cast<Expression*>(expr)->accept(*this);
+    }
+
+    inline auto compileExpression(const ExpressionPtr& expr) -> void {
+        compileExpression(expr.get());
     }
 
     inline auto compileStatement(const StatementPtr& stmt) -> void {
         currentNodeLocation_ = stmt->location();
+        stackDepth_ = 0;
+        invalidateSlots(localsCount_);
         stmt->accept(*this);
     }
 
@@ -65,7 +171,7 @@ private:
              typename = std::enable_if_t<std::is_same_v<T, Byte> || 
                                          std::is_same_v<T, OpCode>>>
     inline auto emit(T byte) -> void {
-        currentChunk().write(byte, currentNodeLocation_.start.line);
+        currentChunk().write(byte, currentNodeLocation_.start.offset);
     }
 
     inline auto emitJump(OpCode instruction) -> Short {
@@ -112,6 +218,8 @@ private:
             emit(OpCode::Pop);
             localsCount_--;
         }
+
+        invalidateSlots(localsCount_);
     }
 
     auto addLocal(const Token& name) -> std::uint8_t;
@@ -119,6 +227,47 @@ private:
     auto defineVariable(const Token& name) -> void;
     auto markVariableAsDefined() -> void;
     auto resolveVariableName(const Token& name) -> int;
+    auto findLocal(std::string_view name) const -> int;
+
+    auto numericConstant(const Expression* expr) const -> std::optional<Value>;
+    auto constantValue(const Expression* expr) const -> std::optional<Value>;
+    auto evaluateCall(const CallExpression& expr) const -> std::optional<Value>;
+    auto isNumericExpression(const Expression* expr) const -> bool;
+    auto simplifyBinaryExpression(const BinaryExpression& expr) -> bool;
+    auto emitConstant(Value number) -> void;
+
+    auto annotationOf(std::string_view name) const -> TypeAnnotation;
+    auto staticType(const Expression* expr) const -> std::optional<TypeAnnotation>;
+    auto checkAnnotation(TypeAnnotation type, const Expression* value) -> bool;
+    auto emitTypeCheck(TypeAnnotation type, const Expression* value) -> void;
+    auto checkArguments(const CallExpression& expr) -> void;
+
+    auto isProvenNumber(const Expression* expr) const -> bool;
+    auto isConstantGlobal(std::string_view name) const -> bool;
+    auto constantGlobal(std::string_view name) const -> const Expression*;
+    auto promotesGlobal(const VariableDeclaration& decl) const -> bool;
+    auto isLiteralValue(const Expression* expr) const -> bool;
+    auto isKnownNumber(const Expression* expr) const -> bool;
+    auto cannotFail(const Expression* expr) const -> bool;
+    auto isWorthHoisting(const Expression* expr) const -> bool;
+    auto collectInvariants(const Expression* expr, const LoopSummary& loop, bool& guaranteed,
+                           std::vector<const Expression*>& invariants) const -> bool;
+    auto hoistInvariants(const WhileStatement& stmt) -> std::vector<const Expression*>;
+    auto compileInduction(const AssignmentExpression& expr) -> bool;
+
+    auto isCseCandidate(const Expression* expr, std::vector<int>& reads) const -> bool;
+    auto sameExpression(const Expression* lhs, const Expression* rhs) const -> bool;
+    auto findAvailable(const Expression* expr) const -> int;
+    auto makeAvailable(const Expression* expr, int slot) -> void;
+    auto invalidateSlots(int from) -> void;
+    auto invalidateLocal(int slot) -> void;
+
+    auto findInlineBinding(std::string_view name) const -> const InlineBinding*;
+    auto isTrivialArgument(const Expression* expr) const -> bool;
+    auto inlineCall(const CallExpression& expr) -> bool;
+    auto reportInline(const CallExpression& expr, const char* verdict) -> void;
+    auto isHotFunction(std::string_view name) const -> bool;
+    auto isHotThenBranch(const IfStatement& stmt) const -> bool;
 
     template<typename... Args>
     auto emitError(const char* fmt, Args&&... args) -> void;
@@ -129,7 +278,9 @@ private:
 
     auto visitBlock(const Block& block) -> void;
     auto visitWhileStatement(const WhileStatement& stmt) -> void;
+    auto visitForStatement(const ForStatement& stmt) -> void;
     auto visitIfStatement(const IfStatement& stmt) -> void;
+    auto visitMatchStatement(const MatchStatement& stmt) -> void;
     auto visitExpressionStatement(const ExpressionStatement& stmt) -> void;
     auto visitContinueStatement(const ContinueStatement& stmt) -> void;
     auto visitBreakStatement(const BreakStatement& stmt) -> void;
@@ -148,7 +299,36 @@ private:
 
     FunctionType type_;
     ErrorReporter* reporter_;
-    bool debugMode_;
+    CompilerOptions options_;
+
+    const ProgramAnalysis* analysis_ = nullptr;
+    const TypeInference* types_ = nullptr;
+    int topLevelIndex_ = 0;
+
+    // Runs calls to pure functions with constant arguments at compile
+    // time, holding every pure function compiled so far.
+    VM* evaluator_ = nullptr;
+    mutable std::unordered_map<const Expression*, std::optional<Value>> evaluated_;
+
+    // Instructions left to all the evaluations of the script, a single one
+    // runs at most EVALUATION_FUEL of them.
+    std::uint64_t* evaluationBudget_ = nullptr;
+
+    // Number of temporaries above the locals at the current emission
+    // point, so stack positions can be addressed as frame slots.
+    int stackDepth_ = 0;
+
+    InlineFrame* inline_ = nullptr;
+    int inlineDepth_ = 0;
+
+    // Loop-invariant expressions and global reads evaluated once before
+    // the enclosing loops, mapped to the hidden local holding the value.
+    std::unordered_map<const Expression*, int> hoisted_;
+    std::unordered_map<std::string_view, int> hoistedGlobals_;
+
+    // Value numbering table of the current basic block.
+    std::vector<AvailableExpression> available_;
+    std::uint32_t availableId_ = 0;
 
     SourceRange currentNodeLocation_;
 
@@ -162,6 +342,9 @@ private:
     
 };
 
+// Gives the integer cases of a `match` a dense array when they fill at
+// least half of their range.
+auto packCaseTable(CaseTable& table) -> void;
 
 }
 
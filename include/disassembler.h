@@ -13,14 +13,18 @@ public:
     Disassembler(std::ostream& stream)
         : stream_(stream) {}
     
-    auto disassembleChunk(const char* name, Chunk& chunk) -> void;
-    auto disassembleInstruction(Chunk& chunk, int offset) -> int;
+    auto disassembleChunk(const char* name, const Chunk& chunk) -> void;
+    auto disassembleInstruction(const Chunk& chunk, int offset) -> int;
 
 private:
     auto simpleInstruction(const char* name, int offset) -> int;
-    auto byteInstruction(const char* name, Chunk& chunk, int offset) -> int;
-    auto jumpInstruction(const char* name, Chunk& chunk, int sign, int offset) -> int;
-    auto constantInstruction(const char* name, Chunk& chunk, int offset) -> int;
+    auto byteInstruction(const char* name, const Chunk& chunk, int offset) -> int;
+    auto jumpInstruction(const char* name, const Chunk& chunk, int sign, int offset) -> int;
+    auto forInstruction(const char* name, const Chunk& chunk, int sign, int offset) -> int;
+    auto jumpTableInstruction(const char* name, const Chunk& chunk, int offset) -> int;
+    auto constantInstruction(const char* name, const Chunk& chunk, int offset) -> int;
+    auto localConstantInstruction(const char* name, const Chunk& chunk, int offset) -> int;
+    auto checkInstruction(const char* name, const Chunk& chunk, bool local, int offset) -> int;
     
 private:
     std::ostream& stream_;
@@ -0,0 +1,84 @@
+#ifndef _DOCUMENT_H_
+#define _DOCUMENT_H_
+
+#include "ast.h"
+#include "error_reporter.h"
+#include "source_position.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scriptlang::parser {
+
+using namespace ast;
+using namespace error;
+
+// A parse error placed in a Document, line and column counted from 1.
+struct Diagnostic {
+    std::uint32_t line;
+    std::uint32_t column;
+    std::string message;
+};
+
+// A source kept parsed across edits, for editors. The text is split into
+// segments, one per top-level declaration with the whitespace and comments
+// before it, each with a copy of its text and its own Program. An edit
+// parses again from the first declaration whose text or read-ahead token
+// reaches the edited range until one ends where an old one did, the
+// segments after it are kept as they are. A
+// top-level declaration parses the same wherever it starts, the result is
+// the one of parsing the whole text.
+class Document final {
+
+    struct Segment {
+        // Up to the end of the token read ahead after the declaration,
+        // errors may point at it. Tokens and nodes point into the text.
+        std::unique_ptr<std::string> text;
+        std::uint32_t length;
+
+        Program program;
+
+        // Positions relative to the start of the segment.
+        std::vector<Diagnostic> errors;
+
+        // Newlines of the first `length` bytes, and the bytes after the
+        // last one, to place the segments that follow.
+        std::uint32_t newlines;
+        std::uint32_t lastLine;
+    };
+
+public:
+    explicit Document(std::string text);
+
+    // Replaces `length` bytes at `offset` with `text`, the range must be in
+    // the document. Returns the number of declarations parsed again.
+    auto edit(std::uint32_t offset, std::uint32_t length, std::string_view text) -> std::size_t;
+
+    auto diagnostics() const -> std::vector<Diagnostic>;
+
+    inline auto text() const -> const std::string& {
+        return text_;
+    }
+
+    inline auto declarations() const -> std::size_t {
+        return segments_.size();
+    }
+
+private:
+    auto reparse(std::size_t first, std::uint32_t start,
+                 std::uint32_t editEnd, std::int64_t delta) -> std::size_t;
+
+    static auto parseSegment(std::string_view text, std::uint32_t length) -> Segment;
+
+private:
+    std::string text_;
+    std::vector<Segment> segments_;
+};
+
+}
+
+#endif
@@ -5,11 +5,13 @@
 #include <vector>
 #include <memory>
 
+#include "source_manager.h"
 #include "source_position.h"
 #include "utils.h"
 
 namespace scriptlang::error {
 
+using scriptlang::lexer::SourceManager;
 using scriptlang::lexer::SourceRange;
 using scriptlang::utils::format;
 
@@ -37,9 +39,29 @@ private:
     bool hadError_ = false;
 };
 
+// Keeps the errors with their ranges, for callers that place them in the
+// source themselves.
+class RecordingErrorReporter : public ErrorReporter {
+public:
+    struct Entry {
+        std::string message;
+        SourceRange location;
+    };
+
+    inline auto entries() const -> const std::vector<Entry>& {
+        return entries_;
+    }
+
+    auto error(const std::string& message, SourceRange location) -> void;
+
+private:
+    std::vector<Entry> entries_;
+};
+
 class BasicErrorReporter : public ErrorReporter {
 public:
-    BasicErrorReporter() = default;
+    explicit BasicErrorReporter(const SourceManager& sources)
+        : sources_(sources) {}
 
     inline auto errors() const -> const std::vector<std::string>& {
         return errors_;
@@ -48,6 +70,7 @@ public:
     auto error(const std::string& message, SourceRange location) -> void;
   
 private:
+    const SourceManager& sources_;
     std::vector<std::string> errors_;
 
 };
@@ -0,0 +1,111 @@
+#ifndef _IR_H_
+#define _IR_H_
+
+#include "value.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace scriptlang::ir {
+
+using runtime::Value;
+
+enum class Op : std::uint8_t {
+    Constant,
+    Parameter,
+    Function,
+    Phi,
+
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Pow,
+    Less,
+    Greater,
+    Equal,
+    Not,
+    Negate,
+    Check,
+
+    GetGlobal,
+    SetGlobal,
+    DefineGlobal,
+    Call,
+    Print,
+
+    Jump,
+    Branch,
+    Return
+};
+
+struct BasicBlock;
+
+struct Instruction final {
+    Instruction(Op op, std::uint32_t id, std::uint32_t location, BasicBlock* block)
+        : op(op), id(id), location(location), block(block) {}
+
+    Op op;
+    std::uint32_t id;
+    std::uint32_t location;
+
+    BasicBlock* block;
+
+    std::vector<Instruction*> operands;
+    std::vector<Instruction*> users;
+
+    // Constant value, global name, parameter/function index, call arity or
+    // checked type.
+    Value constant;
+    std::string name;
+    int index = 0;
+
+    BasicBlock* targets[2] = { nullptr, nullptr };
+
+    // Set when a trivial phi is folded away during SSA construction.
+    Instruction* replacement = nullptr;
+
+    auto hasResult() const -> bool;
+    auto isTerminator() const -> bool;
+
+    auto addOperand(Instruction* value) -> void;
+    auto replaceAllUsesWith(Instruction* value) -> void;
+    auto removeUser(Instruction* user) -> void;
+};
+
+struct BasicBlock final {
+    explicit BasicBlock(std::uint32_t id)
+        : id(id) {}
+
+    std::uint32_t id;
+
+    std::vector<std::unique_ptr<Instruction>> phis;
+    std::vector<std::unique_ptr<Instruction>> instructions;
+
+    std::vector<BasicBlock*> predecessors;
+    std::vector<BasicBlock*> successors;
+
+    auto terminator() const -> Instruction*;
+};
+
+struct Function final {
+    std::string name;
+    int arity = 0;
+
+    // Entry block first.
+    std::vector<std::unique_ptr<BasicBlock>> blocks;
+
+    // Functions declared by this one, referenced by Op::Function.
+    std::vector<std::unique_ptr<Function>> functions;
+};
+
+auto opName(Op op) -> const char*;
+
+auto print(std::ostream& stream, const Function& function) -> void;
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef _IR_BUILDER_H_
+#define _IR_BUILDER_H_
+
+#include "analysis.h"
+#include "ast.h"
+#include "ir.h"
+
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace scriptlang::ir {
+
+using namespace ast;
+
+// Builds SSA form straight from the AST, following Braun et al.,
+// "Simple and Efficient Construction of Static Single Assignment Form".
+// Expects an AST the Compiler accepted without errors.
+class Builder final : private AstVisitor<Builder> {
+    friend class AstVisitor<Builder>;
+
+    struct Variable {
+        std::string_view name;
+        int id;
+
+        TypeAnnotation type;
+    };
+
+    struct LoopContext {
+        LoopContext* enclosing;
+
+        // Target of `continue`, the loop header or the step of a `for`.
+        BasicBlock* header;
+        BasicBlock* exit;
+    };
+
+public:
+    Builder() = default;
+
+    auto build(const StatementList& program) -> std::unique_ptr<Function>;
+
+private:
+    auto buildFunction(const FunctionDeclaration& decl) -> std::unique_ptr<Function>;
+
+    auto buildStatements(const StatementList& statements) -> void;
+    auto buildExpression(const ExpressionPtr& expr) -> Instruction*;
+
+    auto newBlock() -> BasicBlock*;
+    auto newInstruction(Op op, BasicBlock* block) -> std::unique_ptr<Instruction>;
+
+    auto append(Op op, std::initializer_list<Instruction*> operands = {}) -> Instruction*;
+    auto constant(Value value) -> Instruction*;
+    auto check(Instruction* value, TypeAnnotation type) -> Instruction*;
+
+    auto jump(BasicBlock* target) -> void;
+    auto branch(Instruction* condition, BasicBlock* then, BasicBlock* otherwise) -> void;
+    auto addEdge(BasicBlock* from, BasicBlock* to) -> void;
+    auto isTerminated() const -> bool;
+
+    auto beginScope() -> void;
+    auto endScope() -> void;
+    auto declareVariable(std::string_view name, TypeAnnotation type = TypeAnnotation::None) -> int;
+    auto resolveVariable(std::string_view name) const -> int;
+    auto annotationOf(std::string_view name) const -> TypeAnnotation;
+
+    auto writeVariable(int variable, BasicBlock* block, Instruction* value) -> void;
+    auto readVariable(int variable, BasicBlock* block) -> Instruction*;
+    auto readVariableRecursive(int variable, BasicBlock* block) -> Instruction*;
+    auto addPhiOperands(int variable, Instruction* phi) -> Instruction*;
+    auto tryRemoveTrivialPhi(Instruction* phi) -> Instruction*;
+    auto sealBlock(BasicBlock* block) -> void;
+
+    auto removeUnreachableBlocks() -> void;
+    auto removeReplacedPhis() -> void;
+    auto renumber() -> void;
+
+private:
+    auto visitVariableDeclaration(const VariableDeclaration& decl) -> void;
+    auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void;
+
+    auto visitBlock(const Block& block) -> void;
+    auto visitWhileStatement(const WhileStatement& stmt) -> void;
+    auto visitForStatement(const ForStatement& stmt) -> void;
+    auto visitIfStatement(const IfStatement& stmt) -> void;
+    auto visitMatchStatement(const MatchStatement& stmt) -> void;
+    auto visitExpressionStatement(const ExpressionStatement& stmt) -> void;
+    auto visitContinueStatement(const ContinueStatement& stmt) -> void;
+    auto visitBreakStatement(const BreakStatement& stmt) -> void;
+    auto visitReturnStatement(const ReturnStatement& stmt) -> void;
+    auto visitPrintStatement(const PrintStatement& stmt) -> void;
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void;
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void;
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void;
+    auto visitCallExpression(const CallExpression& expr) -> void;
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void;
+    auto visitVariableExpression(const VariableExpression& expr) -> void;
+    auto visitLiteralExpression(const LiteralExpression& expr) -> void;
+
+private:
+    const analysis::ProgramAnalysis* analysis_ = nullptr;
+
+    Function* function_ = nullptr;
+    BasicBlock* current_ = nullptr;
+
+    std::uint32_t nextId_ = 0;
+    std::uint32_t location_ = 0;
+
+    Instruction* value_ = nullptr;
+    LoopContext* loop_ = nullptr;
+
+    std::vector<std::vector<Variable>> scopes_;
+    std::vector<Variable> promoted_;
+    int variablesCount_ = 0;
+
+    std::unordered_map<BasicBlock*, std::unordered_map<int, Instruction*>> currentDef_;
+    std::unordered_map<BasicBlock*, std::unordered_map<int, Instruction*>> incompletePhis_;
+    std::unordered_set<BasicBlock*> sealed_;
+};
+
+}
+
+#endif
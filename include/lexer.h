@@ -3,30 +3,46 @@
 
 #include "token.h"
 
-#include <map>
+#include <future>
+#include <vector>
 
 namespace scriptlang::lexer {
 
+// Sources of at least PARALLEL_THRESHOLD bytes are split at newlines outside
+// of strings and comments, and the pieces are lexed concurrently. next()
+// hands out their tokens in order.
 class Lexer final {
+
+    static constexpr std::size_t PARALLEL_THRESHOLD = 4 << 20;
+
 public:
-    Lexer(std::string_view source);
+    Lexer(SourceBuffer source);
 
     auto next() -> Token;
     auto hasNext() const -> bool;
 
 private:
+    Lexer(SourceBuffer source, std::size_t threads);
+
+    auto scan() -> Token;
+
+    auto findSplits(std::size_t count) const -> std::vector<std::uint32_t>;
+    auto lexChunks(std::size_t count) -> void;
+    auto nextFromChunks() -> Token;
 
     auto stringLiteral() -> Token;
     auto numberLiteral() -> Token;
 
-    auto getIdentiferType() -> TokenType;
-    auto isValidIdentiferCharacter(char c) const -> bool;
+    auto getIdentiferType() const -> TokenType;
     auto identifier() -> Token;
 
     auto advance() -> char;
+    auto advanceTo(const char* stop) -> void;
     auto peek(std::uint32_t pos = 0) const -> char;
     auto match(char c) -> bool;
 
+    auto position() const -> const char*;
+    auto end() const -> const char*;
     auto isAtEnd() const -> bool;
 
     auto getCurrentPosition() const -> SourcePosition;
@@ -37,20 +53,19 @@ private:
 private:
 
     std::string_view source_;
+    std::uint32_t base_;
     bool hasNext_ = true;
 
     std::string_view::const_iterator curr_;
     std::string_view::const_iterator start_;
 
-    std::uint32_t line_ = 1;
-    std::uint32_t column_ = 0;
-
-    std::uint32_t startLine_ = 1;
-    std::uint32_t startColumn_ = 0;
-
-    std::map<std::string_view, TokenType> keywords_;
-
     SourcePosition tokenStartPosition_;
+
+    // Parallel mode, each chunk's tokens end with its own Eof.
+    std::vector<std::future<std::vector<Token>>> chunks_;
+    std::vector<Token> tokens_;
+    std::size_t chunk_ = 0;
+    std::size_t index_ = 0;
 };
 
 }
@@ -0,0 +1,74 @@
+#ifndef _MEMO_H_
+#define _MEMO_H_
+
+#include "value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace scriptlang::runtime {
+
+// Results of a `@memo` function keyed by its arguments, shared by every
+// copy of the function. Holds at most `capacity` entries and evicts the
+// least recently used one when full.
+class MemoCache final {
+
+    struct Entry {
+        std::vector<Value> key;
+        std::size_t hash;
+
+        Value result;
+    };
+
+    using Entries = std::list<Entry>;
+
+public:
+    static constexpr std::size_t CAPACITY = 4096;
+
+    explicit MemoCache(std::size_t capacity = CAPACITY)
+        : capacity_(capacity) {}
+
+    // Functions have no identity to compare, calls passing one bypass the cache.
+    static auto isKey(const Value* args, int argc) -> bool;
+
+    auto find(const Value* args, int argc) -> const Value*;
+    auto insert(std::vector<Value> key, Value result) -> void;
+
+    inline auto hits() const -> std::uint64_t {
+        return hits_;
+    }
+
+    inline auto misses() const -> std::uint64_t {
+        return misses_;
+    }
+
+    inline auto evictions() const -> std::uint64_t {
+        return evictions_;
+    }
+
+    inline auto size() const -> std::size_t {
+        return entries_.size();
+    }
+
+private:
+    auto lookup(const Value* args, int argc, std::size_t hash) -> Entries::iterator;
+    auto evict() -> void;
+
+private:
+    std::size_t capacity_;
+
+    // Most recently used first.
+    Entries entries_;
+    std::unordered_multimap<std::size_t, Entries::iterator> index_;
+
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+    std::uint64_t evictions_ = 0;
+};
+
+}
+
+#endif
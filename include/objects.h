@@ -3,10 +3,16 @@
 
 #include "chunk.h"
 
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 
 namespace scriptlang::runtime {
 
+class MemoCache;
+struct LazyBody;
+
 struct ObjectFunction {
 
     ObjectFunction() = default;
@@ -16,12 +22,24 @@ struct ObjectFunction {
 
     Chunk chunk;
 
+    // Set for `@memo` functions.
+    std::shared_ptr<MemoCache> memo;
+
+    // Set when the body is compiled on the first call, `chunk` is then
+    // left empty, see LazyBody.
+    std::shared_ptr<LazyBody> lazy;
+
     auto operator==([[maybe_unused]] const ObjectFunction& rhs) const -> bool {
         return false;
     }
 };
 
-
+// A function body only checked by the SinglePassCompiler. The VM compiles it
+// on the first call, all the copies of the function then run that chunk.
+struct LazyBody {
+    std::function<auto () -> std::optional<Chunk>> compile;
+    std::shared_ptr<const Chunk> chunk;
+};
 
 }
 
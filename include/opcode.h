@@ -22,6 +22,7 @@ enum OpCode : Byte {
     Negate,
     Print,
     JumpIfFalse,
+    JumpIfTrue,
     Jump,
     Loop,
     GetLocal,
@@ -34,6 +35,27 @@ enum OpCode : Byte {
     True,
     False,
     Nil,
+    Dup,
+    IncrLocal,
+    DecrLocal,
+    AddNum,
+    SubNum,
+    MultNum,
+    DivNum,
+    LessNum,
+    GreaterNum,
+    CheckType,
+    CheckLocal,
+    ForPrep,
+    ForLoop,
+    JumpTable,
+};
+
+// Operand of CheckType and CheckLocal, mirrors ast::TypeAnnotation.
+enum class CheckedType : Byte {
+    Number = 1,
+    String,
+    Boolean
 };
 
 
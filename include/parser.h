@@ -1,4 +1,4 @@
-#ifndef _PARSER_H_p
+#ifndef _PARSER_H_
 #define _PARSER_H_
 
 #include "ast.h"
@@ -7,6 +7,7 @@
 #include "source_position.h"
 #include "token.h"
 
+#include <array>
 #include <optional>
 #include <type_traits>
 #include <utility>
@@ -42,46 +43,68 @@ class Parser {
         ParsePrefix prefix;
     };
 
+    // Indexed by token type, built at compile time.
+    using ParseRules = std::array<ParseRule, static_cast<std::size_t>(TokenType::Eof) + 1>;
+
 public:
-    Parser(std::string_view source, ErrorReporter* reporter = nullptr);
+    Parser(SourceBuffer source, ErrorReporter* reporter = nullptr);
+
+    [[nodiscard]]
+    auto parseSoruce() -> Program;
 
+    // Parses up to `count` top-level declarations into a Program of their
+    // own, so their nodes are released with it. Empty at the end of the
+    // source.
     [[nodiscard]]
-    auto parseSoruce() -> std::vector<StatementPtr>;
+    auto parseDeclarations(std::size_t count) -> Program;
+
+    // The declarations parsed so far end with the previous token, the
+    // current one has already been read ahead.
+    inline auto parsedEnd() const -> SourcePosition {
+        return prev_.position.end;
+    }
+
+    inline auto lookaheadEnd() const -> SourcePosition {
+        return curr_.position.end;
+    }
+
+    // A type annotation or `@memo` was parsed, only the whole program
+    // checks them.
+    inline auto parsedAnnotations() const -> bool {
+        return parsedAnnotations_;
+    }
 
 private:
 
     auto declaration() -> StatementPtr;
 
     auto variableDeclaration() -> StatementPtr;
-    auto functionDeclaration() -> StatementPtr;
+    auto functionDeclaration(bool memoized = false) -> StatementPtr;
+    auto annotatedDeclaration() -> StatementPtr;
     auto typeDeclaration() -> StatementPtr;
+    auto typeAnnotation() -> TypeAnnotation;
 
     auto statement() -> StatementPtr;
     
     auto block() -> StatementPtr;
     auto ifStatement() -> StatementPtr;
     auto whileStatement() -> StatementPtr;
+    auto forStatement() -> StatementPtr;
+    auto matchStatement() -> StatementPtr;
+    auto matchLabel() -> ExpressionPtr;
     auto expressionStatement() -> StatementPtr;
     auto continueStatement() -> StatementPtr;
     auto breakStatement() -> StatementPtr;
     auto returnStatement() -> StatementPtr;
     auto printStatement() -> StatementPtr;
 
-    auto getParseRules(TokenType type) -> ParseRule;
-    auto parsePrecedence(Precedence prec) -> ExpressionPtr;
+    static constexpr auto makeParseRules() -> ParseRules;
 
-    inline auto registerRule(TokenType type, Precedence prec, 
-                             ParsePrefix prefix, ParseInfix infix) -> void {
-        rules_[type] = {prec, infix, prefix};
-    }
-    
-    inline auto registerInfix(TokenType type, Precedence prec, ParseInfix infix) -> void {
-        registerRule(type, prec, nullptr, infix);
+    inline static auto getParseRules(TokenType type) -> const ParseRule& {
+        return rules_[static_cast<std::size_t>(type)];
     }
 
-    inline auto registerPrefix(TokenType type, Precedence prec, ParsePrefix prefix) -> void {
-        registerRule(type, prec, prefix, nullptr);
-    }
+    auto parsePrecedence(Precedence prec) -> ExpressionPtr;
 
     auto expression() -> ExpressionPtr;
 
@@ -106,11 +129,11 @@ private:
 
     auto consume(TokenType type, const char *errorMessage) -> std::optional<Token>;
 
-    auto inline previous() const -> Token {
+    auto inline previous() const -> const Token& {
         return prev_;
     }
 
-    auto inline peek() const -> Token {
+    auto inline peek() const -> const Token& {
         return curr_;
     }
 
@@ -126,9 +149,13 @@ private:
 
     Token start_;
 
-    std::map<TokenType, ParseRule> rules_;
+    static const ParseRules rules_;
+
+    // Handed over to the Program at the end of parseSoruce.
+    std::unique_ptr<Arena> arena_;
 
     bool panicMode_ = false;
+    bool parsedAnnotations_ = false;
     ErrorReporter* reporter_;
 
 };
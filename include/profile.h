@@ -0,0 +1,54 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace scriptlang::runtime {
+
+struct BranchCounts {
+    std::uint64_t whenTrue = 0;
+    std::uint64_t whenFalse = 0;
+};
+
+// Execution counts gathered by --profile-out and consumed by the compiler
+// with --profile-in. Everything is keyed by source names and positions, so
+// a profile stays valid whatever the bytecode layout, and the counts of
+// several runs of the same script simply add up.
+//
+// The file is line based and sorted:
+//
+//     scriptlang-profile 1
+//     call <function> <count>
+//     branch <line> <column> <true count> <false count>
+class Profile final {
+public:
+    static constexpr int VERSION = 1;
+
+    // Adds the counts of the file to this profile. False when the file
+    // cannot be read or is not a profile of this version.
+    auto load(const std::string& path) -> bool;
+    auto save(const std::string& path) const -> bool;
+
+    inline auto recordCall(const std::string& function) -> void {
+        calls_[function]++;
+    }
+
+    inline auto recordBranch(std::uint32_t line, std::uint32_t column, bool value) -> void {
+        BranchCounts& counts = branches_[{line, column}];
+        value ? counts.whenTrue++ : counts.whenFalse++;
+    }
+
+    auto calls(const std::string& function) const -> std::uint64_t;
+    auto branch(std::uint32_t line, std::uint32_t column) const -> const BranchCounts*;
+
+private:
+    std::map<std::string, std::uint64_t> calls_;
+    std::map<std::pair<std::uint32_t, std::uint32_t>, BranchCounts> branches_;
+};
+
+}
+
+#endif
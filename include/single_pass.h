@@ -0,0 +1,245 @@
+#ifndef _SINGLE_PASS_H_
+#define _SINGLE_PASS_H_
+
+#include "compiler.h"
+#include "lexer.h"
+#include "objects.h"
+#include "source_position.h"
+#include "token.h"
+#include "types.h"
+#include "value.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace scriptlang::compiler {
+
+using namespace lexer;
+using namespace runtime;
+using namespace types;
+
+// Compiles a script straight from the tokens of the Lexer, no AST is built.
+// Meant for runs that only execute the script, the bytecode is the one the
+// Compiler emits without optimizations. Type annotations and `@memo` need
+// the whole program and errors are reported by the regular pipeline, on
+// any of them compile() gives up and the caller parses the script again.
+//
+// Bodies of the top-level functions are only checked, nothing is emitted for
+// them but the size of their code is counted so every error the compilation
+// could hit is found. The VM compiles a body from its source on the first
+// call, startup only pays for the lexing of the functions never called.
+class SinglePassCompiler final {
+
+    using FunctionType = Compiler::FunctionType;
+
+    // Numeric value of the expression just compiled when it only involves
+    // number literals, the same values Compiler::numericConstant folds.
+    using Constant = std::optional<Value>;
+
+    typedef auto (SinglePassCompiler::*ParseInfix)(const Constant&) -> Constant;
+    typedef auto (SinglePassCompiler::*ParsePrefix)(bool) -> Constant;
+
+    enum Precedence {
+        None,
+        Assignment,
+        LogicOr,
+        LogicAnd,
+        Equality,
+        Comparison,
+        Term,
+        Factor,
+        Unary,
+        Exponent,
+        Call,
+        Primary
+    };
+
+    struct ParseRule {
+        Precedence prec;
+        ParseInfix infix;
+        ParsePrefix prefix;
+    };
+
+    using ParseRules = std::array<ParseRule, static_cast<std::size_t>(TokenType::Eof) + 1>;
+
+    struct Local {
+        std::string_view name;
+        int depth;
+    };
+
+    struct Loop {
+        Loop* enclosing;
+
+        int scopeDepth;
+        std::uint32_t start;
+
+        bool counted = false;
+        std::vector<int> continues;
+        std::vector<int> breaks;
+    };
+
+    // Function being compiled, the script is at the bottom.
+    struct FunctionState {
+        FunctionState(FunctionState* enclosing, FunctionType type)
+            : enclosing(enclosing), type(type) {
+            locals[0] = Local { {}, 0 };
+        }
+
+        FunctionState* enclosing;
+        FunctionType type;
+
+        ObjectFunction function;
+        Loop* loop = nullptr;
+
+        int scopeDepth = 0;
+        int localsCount = 1;
+        Local locals[Compiler::MAX_LOCALS];
+
+        // Skimmed bodies only count the bytes and case tables they would
+        // emit, jumps are checked against the count.
+        bool skimmed = false;
+        std::uint32_t size = 0;
+        std::size_t caseTables = 0;
+    };
+
+public:
+    explicit SinglePassCompiler(SourceBuffer source);
+
+    [[nodiscard]]
+    auto compile() -> std::optional<ObjectFunction>;
+
+private:
+
+    auto declaration() -> void;
+
+    auto variableDeclaration() -> void;
+    auto functionDeclaration() -> void;
+    auto functionBody() -> void;
+    auto typeAnnotation() -> void;
+
+    auto statement() -> void;
+
+    auto block() -> void;
+    auto scopedBlock() -> void;
+    auto ifStatement() -> void;
+    auto whileStatement() -> void;
+    auto forStatement() -> void;
+    auto matchStatement() -> void;
+    auto matchLabel(CaseTable& table, std::uint16_t target) -> void;
+    auto expressionStatement() -> void;
+    auto continueStatement() -> void;
+    auto breakStatement() -> void;
+    auto returnStatement() -> void;
+    auto printStatement() -> void;
+
+    // Compiles the parameters and the body of a skimmed function, `source`
+    // is their range and `position` the start of the declaration.
+    static auto compileBody(SourceBuffer source, std::uint32_t position) -> std::optional<Chunk>;
+
+    static constexpr auto makeParseRules() -> ParseRules;
+
+    inline static auto getParseRules(TokenType type) -> const ParseRule& {
+        return rules_[static_cast<std::size_t>(type)];
+    }
+
+    auto parsePrecedence(Precedence prec) -> Constant;
+
+    auto expression() -> Constant;
+
+    auto assignmentExpression(const Constant& left) -> Constant;
+    auto binaryExpression(const Constant& left) -> Constant;
+    auto callExpression(const Constant& left) -> Constant;
+    auto unaryExpression(bool canAssign) -> Constant;
+    auto groupingExpression(bool canAssign) -> Constant;
+    auto literalExpression(bool canAssign) -> Constant;
+    auto variableExpression(bool canAssign) -> Constant;
+
+private:
+
+    inline auto emit(Byte byte) -> void {
+        current_->skimmed
+            ? static_cast<void>(current_->size++)
+            : currentChunk().write(byte, position_);
+    }
+
+    inline auto emit(OpCode code) -> void {
+        emit(static_cast<Byte>(code));
+    }
+
+    inline auto codeSize() const -> std::uint32_t {
+        return current_->skimmed ? current_->size : current_->function.chunk.size();
+    }
+
+    auto makeConstant(Value value) -> Byte;
+    auto makeConstant(std::string_view string) -> Byte;
+    auto addCaseTable() -> std::size_t;
+
+    auto emitConstant(Value value) -> void;
+    auto emitJump(OpCode instruction) -> int;
+    auto emitLoop(std::uint32_t start) -> void;
+    auto patchJump(int offset) -> void;
+
+    inline auto currentChunk() -> Chunk& {
+        return current_->function.chunk;
+    }
+
+    inline auto beginScope() -> void {
+        current_->scopeDepth++;
+    }
+
+    auto endScope() -> void;
+    auto beginLoop(Loop* loop) -> void;
+    auto endLoop() -> void;
+
+    auto addLocal(std::string_view name) -> void;
+    auto declareVariable(std::string_view name) -> void;
+    auto defineVariable(std::string_view name) -> void;
+    auto markVariableAsDefined() -> void;
+    auto resolveVariableName(std::string_view name) -> int;
+
+    // Gives up on the script, see the class comment.
+    inline auto fail() -> void {
+        failed_ = true;
+    }
+
+    auto advance() -> void;
+    auto check(TokenType type) const -> bool;
+    auto match(TokenType type) -> bool;
+    auto consume(TokenType type) -> bool;
+
+    auto inline previous() const -> const Token& {
+        return prev_;
+    }
+
+    auto inline peek() const -> const Token& {
+        return curr_;
+    }
+
+    auto inline isAtEnd() const -> bool {
+        return !lex_.hasNext();
+    }
+
+private:
+    SourceBuffer source_;
+    Lexer lex_;
+
+    Token curr_;
+    Token prev_;
+
+    static const ParseRules rules_;
+
+    FunctionState* current_ = nullptr;
+
+    // Start of the top-level statement being compiled, the position the
+    // Compiler records for all of its instructions.
+    std::uint32_t position_ = 0;
+
+    bool failed_ = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _SOURCE_MANAGER_H_
+#define _SOURCE_MANAGER_H_
+
+#include "source_position.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace scriptlang::lexer {
+
+// A position with its line and column, both counted from 1.
+struct DecodedPosition final {
+    std::string_view text;
+    std::uint32_t offset;
+
+    std::uint32_t line;
+    std::uint32_t column;
+};
+
+// Owns the source buffers, the file or every REPL line, and maps positions
+// back to them. Positions are 32 bits wide, all buffers together are limited
+// to 4 GB. The line starts of a buffer are indexed on its first decode, only
+// error messages and profiles need them. Decoding is safe from several
+// threads, the pipelined parser reports its errors while the VM runs.
+class SourceManager final {
+
+    struct Buffer {
+        std::string text;
+        std::uint32_t start;
+
+        mutable std::vector<std::uint32_t> lineStarts;
+    };
+
+public:
+    SourceManager() = default;
+
+    SourceManager(const SourceManager&) = delete;
+    auto operator=(const SourceManager&) -> SourceManager& = delete;
+
+    auto add(std::string text) -> SourceBuffer;
+    auto decode(SourcePosition position) const -> DecodedPosition;
+
+private:
+    auto findBuffer(SourcePosition position) const -> const Buffer&;
+
+private:
+    // A deque never moves the strings, the views of the tokens stay valid.
+    std::deque<Buffer> buffers_;
+    std::uint32_t next_ = 0;
+
+    // Guards the line starts.
+    mutable std::mutex mutex_;
+};
+
+}
+
+#endif
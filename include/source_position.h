@@ -7,13 +7,11 @@
 
 namespace scriptlang::lexer {
 
+// A byte of a buffer registered with the SourceManager, counted over all the
+// buffers. Lines and columns are only computed on demand, see
+// SourceManager::decode.
 struct SourcePosition final {
-    
-    std::string_view source;
-
     std::uint32_t offset;
-    std::uint32_t line;
-    std::uint32_t column;
 };
 
 struct SourceRange final {
@@ -26,6 +24,12 @@ struct SourceRange final {
     SourcePosition end;
 };
 
+// The text of a buffer and the position of its first byte.
+struct SourceBuffer final {
+    std::string_view text;
+    std::uint32_t start = 0;
+};
+
 auto operator<<(std::ostream& stream, SourcePosition position) -> std::ostream&;
 auto operator<<(std::ostream& stream, SourceRange range) -> std::ostream&;
 
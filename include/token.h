@@ -18,6 +18,8 @@ enum class TokenType : std::uint8_t {
     IfKeyword,
     ElseKeyword,
     WhileKeyword,
+    ForKeyword,
+    MatchKeyword,
     ContinueKeyword,
     BreakKeyword,
     ReturnKeyword,
@@ -47,15 +49,18 @@ enum class TokenType : std::uint8_t {
     Dot,
     Comma,
     Semicolon,
+    Colon,
     LeftParen,
     RightParen,
     LeftBrace,
     RightBrace,
+    At,
 
     // Literals
     Identifier,
     StringLiteral,
     NumberLiteral,
+    IntegerLiteral,
     
     Eof
 };
@@ -0,0 +1,108 @@
+#ifndef _TYPE_INFERENCE_H_
+#define _TYPE_INFERENCE_H_
+
+#include "analysis.h"
+#include "ast.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace scriptlang::analysis {
+
+using namespace ast;
+
+// Flow-sensitive inference of the expressions that always evaluate to a
+// number, or fail before producing a value. Locals are tracked through
+// assignments, branches and loops; parameters are numbers when every call
+// site of a function that never escapes passes numbers. Variables and
+// parameters annotated `num` are numbers regardless. Without a
+// ProgramAnalysis (REPL) unannotated parameters and globals stay unknown.
+class TypeInference final : private AstVisitor<TypeInference> {
+    friend class AstVisitor<TypeInference>;
+
+    struct Local {
+        std::string_view name;
+        bool number;
+
+        // Annotated `num`, every assignment is checked to keep it a number.
+        bool annotated = false;
+    };
+
+    using Environment = std::vector<Local>;
+
+    struct LoopContext {
+        LoopContext* enclosing;
+        std::size_t locals;
+
+        std::vector<Environment> breaks;
+        std::vector<Environment> continues;
+    };
+
+public:
+    TypeInference(const StatementList& program, const ProgramAnalysis* analysis);
+
+    inline auto isNumber(const Expression* expr) const -> bool {
+        return numbers_.count(expr) != 0;
+    }
+
+private:
+    auto findEscapes(const StatementList& program) -> void;
+    auto analyzeFunction(const FunctionDeclaration& decl) -> void;
+    auto analyzeStatement(const StatementPtr& stmt) -> void;
+    auto infer(const ExpressionPtr& expr) -> bool;
+
+    auto isConstantNumber(std::string_view name) const -> bool;
+    auto isAnnotatedNumber(std::string_view name) const -> bool;
+    auto isPromotable(std::string_view name) const -> bool;
+    auto findLocal(std::string_view name) -> Local*;
+    auto join(Environment& into, const Environment& from) const -> void;
+
+private:
+    auto visitVariableDeclaration(const VariableDeclaration& decl) -> void;
+    auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void;
+
+    auto visitBlock(const Block& block) -> void;
+    auto visitWhileStatement(const WhileStatement& stmt) -> void;
+    auto visitForStatement(const ForStatement& stmt) -> void;
+    auto visitIfStatement(const IfStatement& stmt) -> void;
+    auto visitMatchStatement(const MatchStatement& stmt) -> void;
+    auto visitExpressionStatement(const ExpressionStatement& stmt) -> void;
+    auto visitContinueStatement(const ContinueStatement& stmt) -> void;
+    auto visitBreakStatement(const BreakStatement& stmt) -> void;
+    auto visitReturnStatement(const ReturnStatement& stmt) -> void;
+    auto visitPrintStatement(const PrintStatement& stmt) -> void;
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void;
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void;
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void;
+    auto visitCallExpression(const CallExpression& expr) -> void;
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void;
+    auto visitVariableExpression(const VariableExpression& expr) -> void;
+    auto visitLiteralExpression(const LiteralExpression& expr) -> void;
+
+private:
+    const ProgramAnalysis* analysis_;
+
+    std::unordered_set<const Expression*> numbers_;
+
+    // Assumed parameter types of the functions whose every call is visible,
+    // and what the call sites of the current pass actually pass.
+    std::unordered_map<std::string_view, std::vector<bool>> params_;
+    std::unordered_map<std::string_view, std::vector<bool>> arguments_;
+    std::unordered_set<std::string_view> escaped_;
+
+    Environment locals_;
+    std::vector<std::size_t> scopes_;
+    LoopContext* loop_ = nullptr;
+
+    int topLevelIndex_ = 0;
+    bool inFunction_ = false;
+    bool reachable_ = true;
+    bool result_ = false;
+};
+
+}
+
+#endif
@@ -10,7 +10,13 @@ namespace scriptlang::utils {
 template<typename Base, typename Derived,
          typename = std::enable_if_t<std::is_base_of_v<Base, Derived>>>
 constexpr auto instanceof(Base* ptr) -> bool {
-    return dynamic_cast<Derived*>(ptr) != nullptr;
+    // Hierarchies without virtual methods tag their objects, the derived
+    // class tells its own apart with classof().
+    if constexpr (std::is_polymorphic_v<Base>){
+        return dynamic_cast<Derived*>(ptr) != nullptr;
+    } else {
+        return ptr != nullptr && Derived::classof(ptr);
+    }
 }
 
 template<typename... Args>
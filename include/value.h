@@ -3,6 +3,8 @@
 
 #include "objects.h"
 
+#include <cmath>
+#include <cstdint>
 #include <ostream>
 #include <variant>
 #include <string>
@@ -14,6 +16,7 @@ public:
     constexpr Value() : data_(std::monostate()) {}
     constexpr Value(bool boolean) : data_(boolean) {}
     constexpr Value(double number) : data_(number) {}
+    constexpr Value(std::int64_t integer) : data_(integer) {}
 
     Value(std::string string) : data_(std::move(string)) {}
     Value(ObjectFunction function) : data_(std::move(function)) {}
@@ -24,8 +27,14 @@ public:
         return std::holds_alternative<std::monostate>(data_);
     }
 
+    // Integers and doubles are both numbers, integers are promoted to
+    // double when an operation mixes them or overflows.
     constexpr auto isNumber() const -> bool {
-        return std::holds_alternative<double>(data_);
+        return std::holds_alternative<double>(data_) || isInteger();
+    }
+
+    constexpr auto isInteger() const -> bool {
+        return std::holds_alternative<std::int64_t>(data_);
     }
 
     constexpr auto isBoolean() const -> bool {
@@ -41,7 +50,13 @@ public:
     }
 
     constexpr auto asNumber() const -> double {
-        return std::get<double>(data_);
+        return isInteger()
+            ? static_cast<double>(std::get<std::int64_t>(data_))
+            : std::get<double>(data_);
+    }
+
+    constexpr auto asInteger() const -> std::int64_t {
+        return std::get<std::int64_t>(data_);
     }
     
     constexpr auto asBoolean() const -> bool {
@@ -56,22 +71,112 @@ public:
         return std::get<ObjectFunction>(data_);
     }
 
+    constexpr auto asFunction() const -> const ObjectFunction& {
+        return std::get<ObjectFunction>(data_);
+    }
+
     constexpr auto isCallable() const -> bool {
         return isFunction();
     }
 
     inline auto operator==(const Value& rhs) -> bool {
+
+        if(isNumber() && rhs.isNumber() && isInteger() != rhs.isInteger()){
+            return asNumber() == rhs.asNumber();
+        }
+
         return data_ == rhs.data_;
     }
 
     friend auto operator<<(std::ostream& out, const Value& value) -> std::ostream&;
 
 private:
-    std::variant<bool, double, std::string, ObjectFunction, std::monostate> data_;
+    std::variant<bool, double, std::int64_t, std::string, ObjectFunction, std::monostate> data_;
 };
 
 auto operator<<(std::ostream& out, const Value& value) -> std::ostream&;
 
+// Number arithmetic, shared by the VM and constant folding so both agree
+// bit for bit. Operands must be numbers. Two integers give an integer
+// unless the result overflows, then the operation is redone in double
+// precision like any operation involving a double. Division always gives
+// a double, and so does an integer zero that is negative in double
+// precision, -0 keeps its sign as before integers existed.
+
+inline auto addNumbers(const Value& a, const Value& b) -> Value {
+    std::int64_t result;
+
+    if(a.isInteger() && b.isInteger() && !__builtin_add_overflow(a.asInteger(), b.asInteger(), &result)){
+        return result;
+    }
+
+    return a.asNumber() + b.asNumber();
+}
+
+inline auto subtractNumbers(const Value& a, const Value& b) -> Value {
+    std::int64_t result;
+
+    if(a.isInteger() && b.isInteger() && !__builtin_sub_overflow(a.asInteger(), b.asInteger(), &result)){
+        return result;
+    }
+
+    return a.asNumber() - b.asNumber();
+}
+
+inline auto multiplyNumbers(const Value& a, const Value& b) -> Value {
+    std::int64_t result;
+
+    if(a.isInteger() && b.isInteger() && !__builtin_mul_overflow(a.asInteger(), b.asInteger(), &result) &&
+       (result != 0 || (a.asInteger() < 0) == (b.asInteger() < 0))){
+        return result;
+    }
+
+    return a.asNumber() * b.asNumber();
+}
+
+inline auto divideNumbers(const Value& a, const Value& b) -> Value {
+    return a.asNumber() / b.asNumber();
+}
+
+inline auto powerNumbers(const Value& base, const Value& exponent) -> Value {
+
+    if(base.isInteger() && exponent.isInteger() && exponent.asInteger() >= 0){
+        std::int64_t result = 1;
+        std::int64_t factor = base.asInteger();
+        bool overflow = false;
+
+        for(std::int64_t e = exponent.asInteger(); e > 0 && !overflow; e >>= 1){
+            if(e & 1) overflow = __builtin_mul_overflow(result, factor, &result);
+            if(e > 1) overflow = overflow || __builtin_mul_overflow(factor, factor, &factor);
+        }
+
+        if(!overflow) return result;
+    }
+
+    return std::pow(base.asNumber(), exponent.asNumber());
+}
+
+inline auto negateNumber(const Value& value) -> Value {
+
+    if(value.isInteger() && value.asInteger() != INT64_MIN && value.asInteger() != 0){
+        return -value.asInteger();
+    }
+
+    return -value.asNumber();
+}
+
+inline auto lessNumbers(const Value& a, const Value& b) -> bool {
+    return a.isInteger() && b.isInteger()
+        ? a.asInteger() < b.asInteger()
+        : a.asNumber() < b.asNumber();
+}
+
+inline auto greaterNumbers(const Value& a, const Value& b) -> bool {
+    return a.isInteger() && b.isInteger()
+        ? a.asInteger() > b.asInteger()
+        : a.asNumber() > b.asNumber();
+}
+
 
 }
 
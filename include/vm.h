@@ -4,11 +4,16 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "memo.h"
 #include "objects.h"
+#include "profile.h"
+#include "source_manager.h"
 #include "value.h"
 #include "chunk.h"
 #include "types.h"
@@ -16,6 +21,7 @@
 namespace scriptlang::runtime {
 
 using namespace types;
+using lexer::SourceManager;
 
 enum class InterpreterResult {
     Success,
@@ -24,11 +30,27 @@ enum class InterpreterResult {
 
 class VM {
 
+    enum class RunMode {
+        Normal,
+
+        // Compile-time evaluation, see evaluate().
+        Metered,
+
+        // Records branch directions in the profile.
+        Profiled
+    };
+
     struct CallFrame {
         ObjectFunction* function;
 
+        // The function's own chunk, or the one its lazy body compiled to.
+        const Chunk* chunk;
+
         std::uint32_t ip;
         Value* slots;
+
+        // The result is stored in the function's memo cache on return.
+        bool memoized;
     };
 
 public:
@@ -42,12 +64,34 @@ public:
 
     auto execute(ObjectFunction* function) -> InterpreterResult;
 
+    // Call counts and branch directions of the following executions are
+    // added to `profile`, nullptr stops recording.
+    inline auto setProfile(Profile* profile) -> void {
+        profile_ = profile;
+    }
+
+    // Decodes the line of a runtime error, without it none is printed.
+    inline auto setSourceManager(const SourceManager* sources) -> void {
+        sources_ = sources;
+    }
+
+    // Compile-time evaluation. Calls the global function `name` with `args`
+    // without printing anything, giving up after `fuel` instructions, on
+    // any runtime error or on an instruction with a visible side effect.
+    // `fuel` is left with the instructions not used.
+    auto defineGlobal(const std::string& name, Value value) -> void;
+    auto evaluate(const std::string& name, const std::vector<Value>& args,
+                  std::uint64_t& fuel) -> std::optional<Value>;
+
 private:
 
+    template<RunMode Mode>
     auto run() -> InterpreterResult;
     
     auto call(ObjectFunction* function, int argc) -> bool;
     auto callValue(Value& value, int argc) -> bool;
+    auto compileBody(ObjectFunction& function) -> const Chunk*;
+    auto recordBranch(const CallFrame& frame) -> void;
 
     auto resetStack() -> void;
 
@@ -59,7 +103,7 @@ private:
     }
 
     inline auto readByte() -> Byte {
-        return currentFrame()->function->chunk[currentFrame()->ip++];
+        return (*currentFrame()->chunk)[currentFrame()->ip++];
     }
 
     inline auto push(Value value) -> void {
@@ -84,6 +128,17 @@ private:
     Value* stackTop_ = stack_;
 
     std::unordered_map<std::string, Value> globals_;
+
+    // Arguments of the memoized frames, innermost last.
+    std::vector<std::vector<Value>> memoKeys_;
+
+    // Instructions left to an evaluation, runtime errors are not reported
+    // while one is in progress.
+    std::uint64_t fuel_ = 0;
+    bool quiet_ = false;
+
+    Profile* profile_ = nullptr;
+    const SourceManager* sources_ = nullptr;
 };
 
 }
@@ -0,0 +1,545 @@
+#include "../include/analysis.h"
+#include "../include/utils.h"
+
+#include <algorithm>
+
+namespace scriptlang::analysis {
+
+using scriptlang::utils::instanceof;
+
+namespace {
+
+class ExpressionScanner final : private AstVisitor<ExpressionScanner> {
+    friend class AstVisitor<ExpressionScanner>;
+
+public:
+    explicit ExpressionScanner(std::string_view name = {})
+        : name_(name) {}
+
+    auto scan(const Expression& expr) -> void {
+        const_cast<Expression&>(expr).accept(*this);
+    }
+
+    inline auto summary() const -> const ExpressionSummary& {
+        return summary_;
+    }
+
+    inline auto referencesName() const -> bool {
+        return references_;
+    }
+
+private:
+    auto visitVariableDeclaration([[maybe_unused]] const VariableDeclaration& decl) -> void {}
+    auto visitFunctionDeclaration([[maybe_unused]] const FunctionDeclaration& decl) -> void {}
+
+    auto visitBlock([[maybe_unused]] const Block& block) -> void {}
+    auto visitWhileStatement([[maybe_unused]] const WhileStatement& stmt) -> void {}
+    auto visitForStatement([[maybe_unused]] const ForStatement& stmt) -> void {}
+    auto visitIfStatement([[maybe_unused]] const IfStatement& stmt) -> void {}
+    auto visitMatchStatement([[maybe_unused]] const MatchStatement& stmt) -> void {}
+    auto visitExpressionStatement([[maybe_unused]] const ExpressionStatement& stmt) -> void {}
+    auto visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {}
+    auto visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {}
+    auto visitReturnStatement([[maybe_unused]] const ReturnStatement& stmt) -> void {}
+    auto visitPrintStatement([[maybe_unused]] const PrintStatement& stmt) -> void {}
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+        summary_.size++;
+        summary_.hasAssignments = true;
+        summary_.hasNames = true;
+        references_ |= expr.name().lexeme == name_;
+
+        expr.value()->accept(*this);
+    }
+
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void {
+        summary_.size++;
+        expr.left()->accept(*this);
+        expr.right()->accept(*this);
+    }
+
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void {
+        summary_.size++;
+        expr.right()->accept(*this);
+    }
+
+    auto visitCallExpression(const CallExpression& expr) -> void {
+        summary_.size++;
+        summary_.hasCalls = true;
+
+        expr.callee()->accept(*this);
+        for(const auto& arg : expr.arguments()){
+            arg->accept(*this);
+        }
+    }
+
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void {
+        expr.expression()->accept(*this);
+    }
+
+    auto visitVariableExpression(const VariableExpression& expr) -> void {
+        summary_.size++;
+        summary_.hasNames = true;
+        references_ |= expr.name().lexeme == name_;
+    }
+
+    auto visitLiteralExpression([[maybe_unused]] const LiteralExpression& expr) -> void {
+        summary_.size++;
+    }
+
+private:
+    std::string_view name_;
+
+    ExpressionSummary summary_;
+    bool references_ = false;
+};
+
+class LoopScanner final : private AstVisitor<LoopScanner> {
+    friend class AstVisitor<LoopScanner>;
+
+public:
+    auto scan(const WhileStatement& stmt) -> LoopSummary {
+        visitWhileStatement(stmt);
+        return std::move(summary_);
+    }
+
+private:
+    auto root(const ExpressionPtr& expr) -> void {
+        summary_.roots.push_back(expr.get());
+        expr->accept(*this);
+    }
+
+    auto visitVariableDeclaration(const VariableDeclaration& decl) -> void {
+        summary_.written.insert(decl.name().lexeme);
+        root(decl.initializer());
+    }
+
+    auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
+        summary_.written.insert(decl.name().lexeme);
+    }
+
+    auto visitBlock(const Block& block) -> void {
+        for(const auto& stmt : block.statements()){
+            if(stmt != nullptr) stmt->accept(*this);
+        }
+    }
+
+    auto visitWhileStatement(const WhileStatement& stmt) -> void {
+        root(stmt.condition());
+        stmt.body()->accept(*this);
+    }
+
+    auto visitForStatement(const ForStatement& stmt) -> void {
+        summary_.written.insert(stmt.variable().lexeme);
+
+        root(stmt.start());
+        root(stmt.limit());
+        if(stmt.haveStep()) root(stmt.step());
+
+        stmt.body()->accept(*this);
+    }
+
+    auto visitIfStatement(const IfStatement& stmt) -> void {
+        root(stmt.condition());
+        stmt.thenBranch()->accept(*this);
+
+        if(stmt.haveElseBranch()){
+            stmt.elseBranch()->accept(*this);
+        }
+    }
+
+    auto visitMatchStatement(const MatchStatement& stmt) -> void {
+        root(stmt.subject());
+
+        for(const auto& arm : stmt.arms()){
+            arm.body->accept(*this);
+        }
+
+        if(stmt.haveElseBranch()){
+            stmt.elseBranch()->accept(*this);
+        }
+    }
+
+    auto visitExpressionStatement(const ExpressionStatement& stmt) -> void {
+        root(stmt.expression());
+    }
+
+    auto visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {}
+    auto visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {}
+
+    auto visitReturnStatement(const ReturnStatement& stmt) -> void {
+        if(stmt.haveExpression()) root(stmt.expression());
+    }
+
+    auto visitPrintStatement(const PrintStatement& stmt) -> void {
+        root(stmt.expression());
+    }
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+        summary_.written.insert(expr.name().lexeme);
+        expr.value()->accept(*this);
+    }
+
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void {
+        expr.left()->accept(*this);
+        expr.right()->accept(*this);
+    }
+
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void {
+        expr.right()->accept(*this);
+    }
+
+    auto visitCallExpression(const CallExpression& expr) -> void {
+        expr.callee()->accept(*this);
+
+        for(const auto& arg : expr.arguments()){
+            arg->accept(*this);
+        }
+    }
+
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void {
+        expr.expression()->accept(*this);
+    }
+
+    auto visitVariableExpression([[maybe_unused]] const VariableExpression& expr) -> void {}
+    auto visitLiteralExpression([[maybe_unused]] const LiteralExpression& expr) -> void {}
+
+private:
+    LoopSummary summary_;
+};
+
+}
+
+auto summarize(const Expression& expr) -> ExpressionSummary {
+    ExpressionScanner scanner;
+    scanner.scan(expr);
+
+    return scanner.summary();
+}
+
+auto references(const Expression& expr, std::string_view name) -> bool {
+    ExpressionScanner scanner(name);
+    scanner.scan(expr);
+
+    return scanner.referencesName();
+}
+
+auto summarizeLoop(const WhileStatement& stmt) -> LoopSummary {
+    LoopScanner scanner;
+    return scanner.scan(stmt);
+}
+
+ProgramAnalysis::ProgramAnalysis(const StatementList& program,
+                                 const std::unordered_set<std::string_view>* outside) {
+
+    // Declared and assigned elsewhere as far as the program can tell, so
+    // neither constant, promoted, inlined nor pure.
+    if(outside != nullptr){
+        for(const auto name : *outside){
+            GlobalInfo& info = globals_[name];
+
+            info.declarations = 1;
+            info.assigned = true;
+            info.captured = true;
+        }
+    }
+
+    for(std::size_t i = 0; i < program.size(); i++){
+        Statement* stmt = program[i].get();
+        if(stmt == nullptr) continue;
+
+        const Token* name = nullptr;
+        const FunctionDeclaration* function = nullptr;
+        const Expression* initializer = nullptr;
+        TypeAnnotation annotation = TypeAnnotation::None;
+
+        if(instanceof<Statement, VariableDeclaration>(stmt)){
+            name = &static_cast<VariableDeclaration*>(stmt)->name();
+            initializer = static_cast<VariableDeclaration*>(stmt)->initializer().get();
+            annotation = static_cast<VariableDeclaration*>(stmt)->annotation();
+        } else if(instanceof<Statement, FunctionDeclaration>(stmt)){
+            function = static_cast<FunctionDeclaration*>(stmt);
+            name = &function->name();
+        }
+
+        if(name != nullptr){
+            GlobalInfo& info = globals_[name->lexeme];
+
+            if(info.declarations++ == 0){
+                info.declaredAt = static_cast<int>(i);
+                info.function = function;
+                info.initializer = initializer;
+                info.annotation = annotation;
+            } else {
+                info.function = nullptr;
+                info.initializer = nullptr;
+
+                if(info.annotation != annotation) info.annotation = TypeAnnotation::None;
+            }
+        }
+
+        stmt->accept(*this);
+    }
+
+    std::vector<GlobalInfo*> promoted;
+
+    for(auto& [name, info] : globals_){
+        if(info.function != nullptr) analyzeFunction(*info.function);
+
+        if(info.declarations != 1 || info.initializer == nullptr) continue;
+
+        info.constant = !info.assigned && !summarize(*info.initializer).hasNames;
+
+        if(!info.captured && !references(*info.initializer, name)){
+            promoted.push_back(&info);
+        }
+    }
+
+    // The frame only has room for the first ones in program order.
+    std::sort(promoted.begin(), promoted.end(), [](const GlobalInfo* a, const GlobalInfo* b) {
+        return a->declaredAt < b->declaredAt;
+    });
+
+    if(promoted.size() > static_cast<std::size_t>(MAX_PROMOTED_GLOBALS)){
+        promoted.resize(MAX_PROMOTED_GLOBALS);
+    }
+
+    for(GlobalInfo* info : promoted){
+        info->promotable = true;
+    }
+
+    analyzePurity();
+}
+
+auto ProgramAnalysis::global(std::string_view name) const -> const GlobalInfo* {
+    const auto it = globals_.find(name);
+    return it != globals_.end() ? &it->second : nullptr;
+}
+
+auto ProgramAnalysis::function(std::string_view name) const -> const FunctionInfo* {
+    const auto it = functions_.find(name);
+    return it != functions_.end() ? &it->second : nullptr;
+}
+
+auto ProgramAnalysis::analyzeFunction(const FunctionDeclaration& decl) -> void {
+
+    const GlobalInfo& global = globals_.at(decl.name().lexeme);
+
+    FunctionInfo info;
+    info.declaration = &decl;
+
+    if(global.declarations > 1){
+        info.verdict = InlineVerdict::Redeclared;
+    } else if(global.assigned){
+        info.verdict = InlineVerdict::Reassigned;
+    } else if(!instanceof<Statement, Block>(decl.body().get())){
+        info.verdict = InlineVerdict::NotSingleReturn;
+    } else {
+        const auto& statements = static_cast<Block*>(decl.body().get())->statements();
+
+        if(statements.size() != 1 || !instanceof<Statement, ReturnStatement>(statements[0].get())){
+            info.verdict = InlineVerdict::NotSingleReturn;
+        } else {
+            const auto ret = static_cast<ReturnStatement*>(statements[0].get());
+
+            if(ret->haveExpression()){
+                info.body = ret->expression().get();
+
+                const auto summary = summarize(*info.body);
+                info.size = summary.size;
+                info.hasAssignments = summary.hasAssignments;
+
+                if(references(*info.body, decl.name().lexeme)){
+                    info.verdict = InlineVerdict::Recursive;
+                } else if(info.size > INLINE_BUDGET){
+                    info.verdict = InlineVerdict::TooLarge;
+                }
+            }
+        }
+    }
+
+    functions_[decl.name().lexeme] = info;
+}
+
+auto ProgramAnalysis::analyzePurity() -> void {
+
+    // Optimistic start: every function with a single declaration and no
+    // side effect of its own, then drop the ones reading anything else
+    // until nothing changes. Recursion keeps a function pure.
+    for(auto& [name, info] : functions_){
+        info.pure = info.verdict != InlineVerdict::Redeclared &&
+                    info.verdict != InlineVerdict::Reassigned &&
+                    effects_.count(name) == 0;
+    }
+
+    bool changed = true;
+    while(changed){
+        changed = false;
+
+        for(auto& [name, info] : functions_){
+            if(!info.pure) continue;
+
+            const int declaredAt = globals_.at(name).declaredAt;
+
+            for(const auto read : reads_[name]){
+                const GlobalInfo& global = globals_.at(read);
+                const FunctionInfo* callee = global.function != nullptr ? function(read) : nullptr;
+
+                const bool allowed = callee != nullptr
+                    ? callee->pure
+                    : global.constant && global.declaredAt < declaredAt;
+
+                if(!allowed){
+                    info.pure = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+auto ProgramAnalysis::capture(std::string_view name) -> void {
+
+    if(!inFunction_) return;
+
+    if(!isLocal(name)){
+        globals_[name].captured = true;
+        reads_[function_].push_back(name);
+    }
+}
+
+auto ProgramAnalysis::isLocal(std::string_view name) const -> bool {
+    return std::find(locals_.rbegin(), locals_.rend(), name) != locals_.rend();
+}
+
+auto ProgramAnalysis::visitVariableDeclaration(const VariableDeclaration& decl) -> void {
+    decl.initializer()->accept(*this);
+
+    if(inFunction_) locals_.push_back(decl.name().lexeme);
+}
+
+auto ProgramAnalysis::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
+
+    inFunction_ = true;
+    function_ = decl.name().lexeme;
+
+    for(const auto& param : decl.params()){
+        locals_.push_back(param.lexeme);
+    }
+
+    decl.body()->accept(*this);
+
+    locals_.clear();
+    inFunction_ = false;
+}
+
+auto ProgramAnalysis::visitBlock(const Block& block) -> void {
+
+    const std::size_t scope = locals_.size();
+
+    for(const auto& stmt : block.statements()){
+        if(stmt != nullptr) stmt->accept(*this);
+    }
+
+    locals_.resize(scope);
+}
+
+auto ProgramAnalysis::visitWhileStatement(const WhileStatement& stmt) -> void {
+    stmt.condition()->accept(*this);
+    stmt.body()->accept(*this);
+}
+
+auto ProgramAnalysis::visitForStatement(const ForStatement& stmt) -> void {
+    stmt.start()->accept(*this);
+    stmt.limit()->accept(*this);
+
+    if(stmt.haveStep()){
+        stmt.step()->accept(*this);
+    }
+
+    locals_.push_back(stmt.variable().lexeme);
+    stmt.body()->accept(*this);
+    locals_.pop_back();
+}
+
+auto ProgramAnalysis::visitIfStatement(const IfStatement& stmt) -> void {
+    stmt.condition()->accept(*this);
+    stmt.thenBranch()->accept(*this);
+
+    if(stmt.haveElseBranch()){
+        stmt.elseBranch()->accept(*this);
+    }
+}
+
+auto ProgramAnalysis::visitMatchStatement(const MatchStatement& stmt) -> void {
+    stmt.subject()->accept(*this);
+
+    for(const auto& arm : stmt.arms()){
+        arm.body->accept(*this);
+    }
+
+    if(stmt.haveElseBranch()){
+        stmt.elseBranch()->accept(*this);
+    }
+}
+
+auto ProgramAnalysis::visitExpressionStatement(const ExpressionStatement& stmt) -> void {
+    stmt.expression()->accept(*this);
+}
+
+auto ProgramAnalysis::visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {}
+
+auto ProgramAnalysis::visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {}
+
+auto ProgramAnalysis::visitReturnStatement(const ReturnStatement& stmt) -> void {
+    if(stmt.haveExpression()){
+        stmt.expression()->accept(*this);
+    }
+}
+
+auto ProgramAnalysis::visitPrintStatement(const PrintStatement& stmt) -> void {
+    if(inFunction_) effects_.insert(function_);
+
+    stmt.expression()->accept(*this);
+}
+
+auto ProgramAnalysis::visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+    // Conservative: any assignment to the name, even one that targets a
+    // shadowing local, marks the global as reassigned.
+    globals_[expr.name().lexeme].assigned = true;
+
+    if(inFunction_ && !isLocal(expr.name().lexeme)) effects_.insert(function_);
+    capture(expr.name().lexeme);
+
+    expr.value()->accept(*this);
+}
+
+auto ProgramAnalysis::visitBinaryExpression(const BinaryExpression& expr) -> void {
+    expr.left()->accept(*this);
+    expr.right()->accept(*this);
+}
+
+auto ProgramAnalysis::visitUnaryExpression(const UnaryExpression& expr) -> void {
+    expr.right()->accept(*this);
+}
+
+auto ProgramAnalysis::visitCallExpression(const CallExpression& expr) -> void {
+    expr.callee()->accept(*this);
+
+    for(const auto& arg : expr.arguments()){
+        arg->accept(*this);
+    }
+}
+
+auto ProgramAnalysis::visitGroupingExpression(const GroupingExpression& expr) -> void {
+    expr.expression()->accept(*this);
+}
+
+auto ProgramAnalysis::visitVariableExpression(const VariableExpression& expr) -> void {
+    capture(expr.name().lexeme);
+}
+
+auto ProgramAnalysis::visitLiteralExpression([[maybe_unused]] const LiteralExpression& expr) -> void {}
+
+}
@@ -0,0 +1,55 @@
+#include "../include/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace scriptlang::utils {
+
+auto Arena::adopt(Arena& other) -> void {
+
+    for(auto& block : other.blocks_){
+        blocks_.push_back(std::move(block));
+    }
+
+    capacity_ += other.capacity_;
+
+    other.blocks_.clear();
+    other.next_ = nullptr;
+    other.end_ = nullptr;
+    other.capacity_ = 0;
+}
+
+auto Arena::allocate(std::size_t size, std::size_t alignment) -> void* {
+
+    const auto align = [alignment](std::byte* ptr){
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        return ptr + (-address & (alignment - 1));
+    };
+
+    std::byte* start = next_ != nullptr ? align(next_) : nullptr;
+
+    if(start == nullptr || size > static_cast<std::size_t>(end_ - start)){
+
+        const std::size_t blockSize = std::clamp(capacity_, FIRST_BLOCK_SIZE, BLOCK_SIZE);
+
+        // Objects larger than a quarter block, or than the next one, get
+        // their own, the current block keeps serving the small ones.
+        if(size > BLOCK_SIZE / 4 || size + alignment > blockSize){
+            auto& block = blocks_.emplace_back(new std::byte[size + alignment]);
+            capacity_ += size + alignment;
+            return align(block.get());
+        }
+
+        auto& block = blocks_.emplace_back(new std::byte[blockSize]);
+        capacity_ += blockSize;
+
+        next_ = block.get();
+        end_ = next_ + blockSize;
+        start = align(next_);
+    }
+
+    next_ = start + size;
+    return start;
+}
+
+}
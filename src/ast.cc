@@ -4,7 +4,7 @@
 
 namespace scriptlang::ast::printer {
 
-auto AstPrettyPrinter::print(const std::vector<StatementPtr>& program) -> void {
+auto AstPrettyPrinter::print(const StatementList& program) -> void {
     for(const auto& stmt : program) {
         stmt->accept(*this);
         stream_ << tab() << "\n\n";
@@ -71,6 +71,32 @@ auto AstPrettyPrinter::visitWhileStatement(const WhileStatement& stmt) -> void {
     stream_ << '>';
 }
 
+auto AstPrettyPrinter::visitForStatement(const ForStatement& stmt) -> void { 
+    const char* className = __func__ + 5;
+    stream_ << '<' << className << ": " << stmt.variable().lexeme << '\n';
+    indent();
+    
+    stream_ << tab();
+    stmt.start()->accept(*this);
+    stream_ << '\n';
+
+    stream_ << tab();
+    stmt.limit()->accept(*this);
+    stream_ << '\n';
+
+    if(stmt.haveStep()){
+        stream_ << tab();
+        stmt.step()->accept(*this);
+        stream_ << '\n';
+    }
+
+    stream_ << tab();
+    stmt.body()->accept(*this);
+
+    dedent();
+    stream_ << '>';
+}
+
 auto AstPrettyPrinter::visitIfStatement(const IfStatement& stmt) -> void { 
     const char* className = __func__ + 5;
     stream_ << '<' << className << ":\n";
@@ -92,6 +118,34 @@ auto AstPrettyPrinter::visitIfStatement(const IfStatement& stmt) -> void {
     stream_ << '>';
 }
 
+auto AstPrettyPrinter::visitMatchStatement(const MatchStatement& stmt) -> void { 
+    const char* className = __func__ + 5;
+    stream_ << '<' << className << ":\n";
+    indent();
+    
+    stream_ << tab();
+    stmt.subject()->accept(*this);
+
+    for(const auto& arm : stmt.arms()){
+        stream_ << '\n' << tab();
+
+        for(const auto& label : arm.labels){
+            label->accept(*this);
+            stream_ << ' ';
+        }
+
+        arm.body->accept(*this);
+    }
+
+    if(stmt.haveElseBranch()){
+        stream_ << '\n' << tab();
+        stmt.elseBranch()->accept(*this);
+    }
+
+    dedent();
+    stream_ << '>';
+}
+
 auto AstPrettyPrinter::visitExpressionStatement(const ExpressionStatement& stmt) -> void { 
     const char* className = __func__ + 5;
     stream_ << '<' << className << ":\n";
@@ -229,6 +283,8 @@ auto AstPrettyPrinter::visitLiteralExpression(const LiteralExpression& expr) ->
 
     if(expr.isBoolean()){
         stream_ << std::boolalpha << expr.asBoolean() << std::noboolalpha;
+    } else if(expr.isInteger()){
+        stream_ << expr.asInteger();
     } else if(expr.isNumber()){
         stream_ << expr.asNumber();
     } else if(expr.isString()){
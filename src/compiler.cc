@@ -2,7 +2,10 @@
 #include "../include/disassembler.h"
 #include "../include/utils.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <optional>
 
 namespace scriptlang::compiler {
 
@@ -11,96 +14,1322 @@ using scriptlang::disassembler::Disassembler;
 
 constexpr Byte BREAK_PLACEHOLDER = 0xBB;
 
-auto Compiler::compile(const std::vector<StatementPtr>& ast) -> ObjectFunction {
+auto Compiler::compile(const StatementList& ast) -> ObjectFunction {
 
-    for(const auto& stmt : ast){
-        compileStatement(stmt);
+    std::optional<ProgramAnalysis> analysis;
+    std::optional<TypeInference> types;
+    std::unique_ptr<VM> evaluator;
+    std::uint64_t evaluationBudget = EVALUATION_BUDGET;
+
+    if(type_ == FunctionType::Script && options_.wholeProgram){
+        analysis.emplace(ast, options_.outside);
+        analysis_ = &analysis.value();
+    }
+
+    if(type_ == FunctionType::Script && options_.optimize){
+        types.emplace(ast, analysis_);
+        types_ = &types.value();
+    }
+
+    if(type_ == FunctionType::Script && options_.optimize && analysis_ != nullptr){
+        evaluator = std::make_unique<VM>();
+        evaluator_ = evaluator.get();
+        evaluationBudget_ = &evaluationBudget;
+    }
+
+    for(std::size_t i = 0; i < ast.size(); i++){
+        if(type_ == FunctionType::Script) topLevelIndex_ = static_cast<int>(i);
+        compileStatement(ast[i]);
     }
 
     emit(OpCode::Nil);
     emit(OpCode::Return);
 
-    if(debugMode_){
-        Disassembler disassembler(std::cout);
+    if(analysis.has_value()){
+        analysis_ = nullptr;
+    }
+
+    if(types.has_value()){
+        types_ = nullptr;
+    }
+
+    if(evaluator != nullptr){
+        evaluator_ = nullptr;
+        evaluationBudget_ = nullptr;
+    }
+
+    if(options_.debugMode){
+        Disassembler disassembler(std::cout);
+
+        const char* name = !compilingFunction_.name.empty()
+            ? compilingFunction_.name.c_str()
+            : "<script>";
+
+        disassembler.disassembleChunk(name, compilingFunction_.chunk);
+    }
+
+    return compilingFunction_;
+}
+
+auto Compiler::addLocal(const Token& name) -> std::uint8_t {
+    locals_[localsCount_++] = Local { name, -1, TypeAnnotation::None };
+    return localsCount_ - 1;
+}
+
+auto Compiler::declareVariable(const Token& name) -> void {
+
+    if(scopeDepth_ == 0) return;
+
+    if(localsCount_ > MAX_LOCALS){
+        emitError("Each scope can have maximun 256 locals.");
+        return;
+    }
+
+    const Local* local = nullptr;
+    for(int i = localsCount_ - 1; i >= 0; i--){
+        local = &locals_[i];
+        if(local->depth != -1 && local->depth < scopeDepth_) break;
+
+        if(name.lexeme == local->name.lexeme) {
+            emitError("Variable already declared.");
+            break;
+        }
+    }
+
+    addLocal(name);
+}
+
+auto Compiler::defineVariable(const Token& name) -> void {
+
+    if(scopeDepth_ > 0){
+        markVariableAsDefined();
+        return;
+    }
+
+    Byte index = currentChunk().addConstant(std::string(name.lexeme));
+    emit(OpCode::DefineGlobal);
+    emit(index);
+}
+
+auto Compiler::markVariableAsDefined() -> void {
+    locals_[localsCount_ - 1].depth = scopeDepth_;
+}
+
+auto Compiler::resolveVariableName(const Token& name) -> int {
+
+    if(inline_ != nullptr){
+        const InlineBinding* binding = findInlineBinding(name.lexeme);
+        return binding != nullptr ? binding->slot : -1;
+    }
+
+    const int index = findLocal(name.lexeme);
+
+    if(index != -1 && locals_[index].depth == -1) {
+        emitError("You can't use a variable in it's own initializer.");
+    }
+
+    return index;
+}
+
+auto Compiler::findLocal(std::string_view name) const -> int {
+
+    for(int i = localsCount_ - 1; i >= 0; i--){
+        if(name == locals_[i].name.lexeme) return i;
+    }
+
+    return -1;
+}
+
+auto Compiler::findInlineBinding(std::string_view name) const -> const InlineBinding* {
+
+    for(const auto& binding : inline_->bindings){
+        if(binding.name == name) return &binding;
+    }
+
+    return nullptr;
+}
+
+auto Compiler::isTrivialArgument(const Expression* expr) const -> bool {
+
+    if(instanceof<Expression, LiteralExpression>(const_cast<Expression*>(expr))){
+        return true;
+    }
+
+    if(instanceof<Expression, GroupingExpression>(const_cast<Expression*>(expr))){
+        return isTrivialArgument(static_cast<const GroupingExpression*>(expr)->expression().get());
+    }
+
+    if(!instanceof<Expression, VariableExpression>(const_cast<Expression*>(expr))){
+        return false;
+    }
+
+    // Reads of locals can neither fail nor have side effects, so they can
+    // be evaluated where the parameter is used instead of at the call.
+    const auto name = static_cast<const VariableExpression*>(expr)->name().lexeme;
+
+    if(inline_ == nullptr){
+        const int index = findLocal(name);
+        return index != -1 && locals_[index].depth != -1;
+    }
+
+    const InlineBinding* binding = findInlineBinding(name);
+    return binding != nullptr && binding->slot != -1;
+}
+
+auto Compiler::reportInline(const CallExpression& expr, const char* verdict) -> void {
+
+    if(!options_.inlineReport) return;
+
+    const auto name = static_cast<VariableExpression*>(expr.callee().get())->name().lexeme;
+
+    std::cout << "[Inline] '" << name << "' at [Ln: "
+              << options_.sources->decode(expr.location().end).line << "]: " << verdict << '\n';
+}
+
+auto Compiler::isHotFunction(std::string_view name) const -> bool {
+    return options_.optimize && options_.profile != nullptr &&
+           options_.profile->calls(std::string(name)) >= HOT_CALLS;
+}
+
+auto Compiler::inlineCall(const CallExpression& expr) -> bool {
+
+    if(!options_.optimize || analysis_ == nullptr ||
+       !instanceof<Expression, VariableExpression>(expr.callee().get())){
+        return false;
+    }
+
+    const auto name = static_cast<VariableExpression*>(expr.callee().get())->name().lexeme;
+
+    const bool shadowed = inline_ != nullptr
+        ? findInlineBinding(name) != nullptr
+        : findLocal(name) != -1;
+
+    const FunctionInfo* info = analysis_->function(name);
+    if(shadowed || info == nullptr) return false;
+
+    switch(info->verdict){
+        case analysis::InlineVerdict::Redeclared:
+            reportInline(expr, "not inlined, declared more than once.");
+            return false;
+        case analysis::InlineVerdict::Reassigned:
+            reportInline(expr, "not inlined, reassigned.");
+            return false;
+        case analysis::InlineVerdict::NotSingleReturn:
+            reportInline(expr, "not inlined, body is not a single return statement.");
+            return false;
+        case analysis::InlineVerdict::Recursive:
+            reportInline(expr, "not inlined, recursive.");
+            return false;
+        case analysis::InlineVerdict::TooLarge:
+            if(isHotFunction(name) && info->size <= HOT_INLINE_BUDGET) break;
+
+            reportInline(expr, "not inlined, exceeds the size budget.");
+            return false;
+        case analysis::InlineVerdict::Inlinable:
+            break;
+    }
+
+    const FunctionDeclaration* function = info->declaration;
+
+    // Inlining would bypass the cache.
+    if(function->memoized()){
+        reportInline(expr, "not inlined, memoized.");
+        return false;
+    }
+
+    // The call must run after the declaration, otherwise the original
+    // program fails with an undefined global.
+    if(analysis_->global(name)->declaredAt >= topLevelIndex_){
+        reportInline(expr, "not inlined, declared after the call site.");
+        return false;
+    }
+
+    if(function->params().size() != expr.arguments().size()){
+        reportInline(expr, "not inlined, arity mismatch.");
+        return false;
+    }
+
+    if(inlineDepth_ >= MAX_INLINE_DEPTH){
+        reportInline(expr, "not inlined, maximum inline depth reached.");
+        return false;
+    }
+
+    for(const InlineFrame* frame = inline_; frame != nullptr; frame = frame->enclosing){
+        if(frame->function == function){
+            reportInline(expr, "not inlined, mutually recursive.");
+            return false;
+        }
+    }
+
+    const int baseDepth = stackDepth_;
+
+    if(localsCount_ + baseDepth + static_cast<int>(function->params().size()) >= MAX_LOCALS){
+        reportInline(expr, "not inlined, too many stack slots.");
+        return false;
+    }
+
+    bool substitute = !info->hasAssignments;
+    for(const auto& arg : expr.arguments()){
+        substitute = substitute && !analysis::summarize(*arg).hasAssignments;
+    }
+
+    InlineFrame frame { inline_, function, {} };
+    int firstSlot = -1;
+
+    for(std::size_t i = 0; i < expr.arguments().size(); i++){
+        const auto& arg = expr.arguments()[i];
+        const auto param = function->params()[i].lexeme;
+        const TypeAnnotation type = function->annotations()[i];
+
+        // An annotated parameter is only substituted by a value of its type.
+        const bool typed = type == TypeAnnotation::None || staticType(arg.get()).has_value();
+
+        if(substitute && typed && isTrivialArgument(arg.get())){
+            frame.bindings.push_back({ param, -1, arg.get(), type });
+            continue;
+        }
+
+        const int slot = localsCount_ + stackDepth_;
+        if(firstSlot == -1) firstSlot = slot;
+
+        compileExpression(arg);
+        stackDepth_++;
+
+        frame.bindings.push_back({ param, slot, nullptr, type });
+    }
+
+    // From the checks on entry on, the instructions belong to the callee,
+    // the checks are placed at its declaration as in a call.
+    const std::uint32_t start = currentChunk().size();
+    const SourceRange callLocation = currentNodeLocation_;
+
+    currentNodeLocation_ = function->location();
+
+    // The checks a call performs on entry, after every argument ran.
+    for(std::size_t i = 0; i < frame.bindings.size(); i++){
+        const InlineBinding& binding = frame.bindings[i];
+
+        if(binding.slot == -1 || binding.type == TypeAnnotation::None) continue;
+        if(staticType(expr.arguments()[i].get()).has_value()) continue;
+
+        emit(OpCode::CheckLocal);
+        emit(static_cast<Byte>(binding.slot));
+        emit(static_cast<Byte>(binding.type));
+    }
+
+    reportInline(expr, "inlined.");
+
+    InlineFrame* enclosing = inline_;
+
+    inline_ = &frame;
+    inlineDepth_++;
+
+    if(info->body != nullptr){
+        compileExpression(info->body);
+    } else {
+        emit(OpCode::Nil);
+    }
+
+    inlineDepth_--;
+    inline_ = enclosing;
+    currentNodeLocation_ = callLocation;
+
+    currentChunk().addInlinedCall({
+        start,
+        static_cast<std::uint32_t>(currentChunk().size()),
+        std::string(name),
+        static_cast<int>(function->params().size())
+    });
+
+    // Move the result into the first parameter slot and drop the rest.
+    if(firstSlot != -1){
+        emit(OpCode::SetLocal);
+        emit(static_cast<Byte>(firstSlot));
+
+        for(int i = baseDepth; i < stackDepth_; i++){
+            emit(OpCode::Pop);
+        }
+    }
+
+    stackDepth_ = baseDepth;
+    return true;
+}
+
+auto Compiler::numericConstant(const Expression* expr) const -> std::optional<Value> {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(instanceof<Expression, LiteralExpression>(node)){
+        const auto literal = static_cast<LiteralExpression*>(node);
+
+        if(literal->isInteger()) return Value(literal->asInteger());
+        if(literal->isNumber()) return Value(literal->asNumber());
+
+        return std::nullopt;
+    }
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return numericConstant(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        // The initializer of a constant global has no names, no recursion.
+        const Expression* value = constantGlobal(static_cast<VariableExpression*>(node)->name().lexeme);
+        return value != nullptr ? numericConstant(value) : std::nullopt;
+    }
+
+    if(instanceof<Expression, CallExpression>(node)){
+        const auto value = evaluateCall(*static_cast<CallExpression*>(node));
+        return value.has_value() && value->isNumber() ? value : std::nullopt;
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+        const auto value = numericConstant(unary->right().get());
+
+        if(!value.has_value()) return std::nullopt;
+
+        switch(unary->op().type){
+            case TokenType::Minus:
+                return negateNumber(value.value());
+            case TokenType::Plus:
+                return value;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    if(!instanceof<Expression, BinaryExpression>(node)){
+        return std::nullopt;
+    }
+
+    const auto binary = static_cast<BinaryExpression*>(node);
+
+    const auto left = numericConstant(binary->left().get());
+    if(!left.has_value()) return std::nullopt;
+
+    const auto right = numericConstant(binary->right().get());
+    if(!right.has_value()) return std::nullopt;
+
+    // Same operations the VM performs, so folding is bit-exact.
+    switch(binary->op().type){
+        case TokenType::Plus:
+            return addNumbers(left.value(), right.value());
+        case TokenType::Minus:
+            return subtractNumbers(left.value(), right.value());
+        case TokenType::Star:
+            return multiplyNumbers(left.value(), right.value());
+        case TokenType::Slash:
+            return divideNumbers(left.value(), right.value());
+        case TokenType::Exponent:
+            return powerNumbers(left.value(), right.value());
+        default:
+            return std::nullopt;
+    }
+}
+
+auto Compiler::isNumericExpression(const Expression* expr) const -> bool {
+
+    // True when the expression either fails at runtime or yields a number,
+    // so dropping an identity operation around it is unobservable.
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(numericConstant(expr).has_value()) return true;
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return isNumericExpression(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, AssignmentExpression>(node)){
+        return isNumericExpression(static_cast<AssignmentExpression*>(node)->value().get());
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+
+        switch(unary->op().type){
+            case TokenType::Minus:
+                return true;
+            case TokenType::Plus:
+                return isNumericExpression(unary->right().get());
+            default:
+                return false;
+        }
+    }
+
+    if(!instanceof<Expression, BinaryExpression>(node)){
+        return false;
+    }
+
+    const auto binary = static_cast<BinaryExpression*>(node);
+
+    switch(binary->op().type){
+        case TokenType::Minus:
+        case TokenType::Star:
+        case TokenType::Slash:
+        case TokenType::Exponent:
+            return true;
+        case TokenType::Plus:
+            return isNumericExpression(binary->left().get()) ||
+                   isNumericExpression(binary->right().get());
+        default:
+            return false;
+    }
+}
+
+auto Compiler::constantValue(const Expression* expr) const -> std::optional<Value> {
+
+    if(const auto number = numericConstant(expr)) return number;
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(instanceof<Expression, LiteralExpression>(node)){
+        const auto literal = static_cast<LiteralExpression*>(node);
+
+        if(literal->isBoolean()) return Value(literal->asBoolean());
+        if(literal->isString()) return Value(std::string(literal->asString()));
+
+        return Value();
+    }
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return constantValue(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const Expression* value = constantGlobal(static_cast<VariableExpression*>(node)->name().lexeme);
+        return value != nullptr ? constantValue(value) : std::nullopt;
+    }
+
+    if(instanceof<Expression, CallExpression>(node)){
+        return evaluateCall(*static_cast<CallExpression*>(node));
+    }
+
+    return std::nullopt;
+}
+
+auto Compiler::evaluateCall(const CallExpression& expr) const -> std::optional<Value> {
+
+    if(evaluator_ == nullptr || !instanceof<Expression, VariableExpression>(expr.callee().get())){
+        return std::nullopt;
+    }
+
+    // Evaluations that ran out of fuel are remembered too, the expression
+    // is queried many times while compiling. Inlining may compile the same
+    // node again later, only missing calls that became foldable since.
+    const auto cached = evaluated_.find(&expr);
+    if(cached != evaluated_.end()) return cached->second;
+
+    std::optional<Value>& result = evaluated_[&expr];
+
+    const auto name = static_cast<VariableExpression*>(expr.callee().get())->name().lexeme;
+
+    const bool shadowed = inline_ != nullptr
+        ? findInlineBinding(name) != nullptr
+        : findLocal(name) != -1;
+
+    const FunctionInfo* info = analysis_->function(name);
+    if(shadowed || info == nullptr || !info->pure) return result;
+
+    // The evaluator only holds the functions declared before this point,
+    // any other call fails and is left to run time.
+    std::vector<Value> args;
+    args.reserve(expr.arguments().size());
+
+    for(const auto& arg : expr.arguments()){
+        auto value = constantValue(arg.get());
+        if(!value.has_value()) return result;
+
+        args.push_back(std::move(value.value()));
+    }
+
+    std::uint64_t fuel = std::min(EVALUATION_FUEL, *evaluationBudget_);
+    if(fuel == 0) return result;
+
+    *evaluationBudget_ -= fuel;
+    auto value = evaluator_->evaluate(std::string(name), args, fuel);
+    *evaluationBudget_ += fuel;
+
+    if(value.has_value() && !value->isFunction()){
+        result = std::move(value);
+    }
+
+    return result;
+}
+
+auto Compiler::emitConstant(Value number) -> void {
+    emit(OpCode::PushConstant);
+
+    const Byte index = currentChunk().addConstant(std::move(number));
+    emit(index);
+}
+
+auto Compiler::simplifyBinaryExpression(const BinaryExpression& expr) -> bool {
+
+    const auto folded = numericConstant(&expr);
+
+    if(folded.has_value()){
+        emitConstant(folded.value());
+        return true;
+    }
+
+    const Expression* left = expr.left().get();
+    const Expression* right = expr.right().get();
+
+    const auto leftConstant = numericConstant(left);
+    const auto rightConstant = numericConstant(right);
+
+    // Only identities that hold for every IEEE-754 double and integer
+    // alike are removed. An integer constant keeps the subtype of the other
+    // operand, a double one would turn an integer into a double. x + 0 is
+    // kept because -0 + 0 is +0, x / 1 because division gives a double.
+    const auto isIdentity = [&](const std::optional<Value>& constant, std::int64_t identity) {
+        return constant.has_value() &&
+               constant->isInteger() &&
+               constant->asInteger() == identity;
+    };
+
+    const Expression* operand = nullptr;
+
+    switch(expr.op().type){
+        case TokenType::Minus:
+            if(isIdentity(rightConstant, 0)) operand = left;
+            break;
+        case TokenType::Star:
+            if(isIdentity(rightConstant, 1)) operand = left;
+            else if(isIdentity(leftConstant, 1)) operand = right;
+            break;
+        case TokenType::Slash: {
+            // x / 2^k == x * 2^-k exactly whenever 2^-k is representable,
+            // both round the same real number once.
+            if(!rightConstant.has_value()) break;
+
+            int exponent;
+            const double mantissa = std::frexp(rightConstant->asNumber(), &exponent);
+            const double reciprocal = 1.0 / rightConstant->asNumber();
+
+            if(std::fabs(mantissa) != 0.5 || !std::isfinite(reciprocal)) break;
+
+            compileExpression(left);
+            emitConstant(reciprocal);
+            emit(isProvenNumber(left) ? OpCode::MultNum : OpCode::Mult);
+            return true;
+        }
+        case TokenType::Exponent:
+            if(isIdentity(rightConstant, 1)){
+                operand = left;
+                break;
+            }
+
+            // pow(x, 2) is correctly rounded, as is x * x, and integers
+            // promote on overflow the same way. Larger exponents would round
+            // more than once, so they keep calling pow.
+            if(isIdentity(rightConstant, 2)){
+                compileExpression(left);
+                emit(OpCode::Dup);
+                emit(isProvenNumber(left) ? OpCode::MultNum : OpCode::Mult);
+                return true;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if(operand == nullptr || !isNumericExpression(operand)){
+        return false;
+    }
+
+    compileExpression(operand);
+    return true;
+}
+
+auto Compiler::isConstantGlobal(std::string_view name) const -> bool {
+
+    if(!options_.optimize || analysis_ == nullptr) return false;
+
+    // Defined before the current top-level statement and never assigned:
+    // reading it can neither fail nor observe a different value.
+    const analysis::GlobalInfo* info = analysis_->global(name);
+
+    return info != nullptr &&
+           info->declarations == 1 &&
+           !info->assigned &&
+           info->declaredAt < topLevelIndex_;
+}
+
+auto Compiler::constantGlobal(std::string_view name) const -> const Expression* {
+
+    if(!options_.optimize || analysis_ == nullptr) return nullptr;
+
+    if(inline_ != nullptr){
+        if(findInlineBinding(name) != nullptr) return nullptr;
+    } else {
+        // Script locals at depth 0 are promoted globals, not shadows.
+        const int index = findLocal(name);
+        if(index != -1 && (type_ != FunctionType::Script || locals_[index].depth != 0)) return nullptr;
+    }
+
+    const analysis::GlobalInfo* info = analysis_->global(name);
+    if(info == nullptr || !info->constant || info->declaredAt >= topLevelIndex_) return nullptr;
+
+    return isLiteralValue(info->initializer) ? info->initializer : nullptr;
+}
+
+auto Compiler::isLiteralValue(const Expression* expr) const -> bool {
+
+    // Evaluates to the same value every time and cannot fail, so reading
+    // a global initialized with it is indistinguishable from evaluating it.
+    return numericConstant(expr).has_value() ||
+           instanceof<Expression, LiteralExpression>(const_cast<Expression*>(expr));
+}
+
+auto Compiler::promotesGlobal(const VariableDeclaration& decl) const -> bool {
+
+    if(!options_.optimize || analysis_ == nullptr) return false;
+    if(type_ != FunctionType::Script || scopeDepth_ != 0 || inline_ != nullptr) return false;
+
+    const analysis::GlobalInfo* info = analysis_->global(decl.name().lexeme);
+    return info != nullptr && info->promotable;
+}
+
+auto Compiler::annotationOf(std::string_view name) const -> TypeAnnotation {
+
+    if(inline_ != nullptr){
+        const InlineBinding* binding = findInlineBinding(name);
+        if(binding != nullptr) return binding->type;
+    } else {
+        const int index = findLocal(name);
+        if(index != -1) return locals_[index].type;
+    }
+
+    // Without the whole program a later line may assign anything.
+    const analysis::GlobalInfo* info = analysis_ != nullptr ? analysis_->global(name) : nullptr;
+
+    return info != nullptr ? info->annotation : TypeAnnotation::None;
+}
+
+auto Compiler::staticType(const Expression* expr) const -> std::optional<TypeAnnotation> {
+
+    // The type every evaluation produces unless it fails first, None for nil.
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(isProvenNumber(expr)) return TypeAnnotation::Number;
+
+    if(instanceof<Expression, LiteralExpression>(node)){
+        const auto literal = static_cast<LiteralExpression*>(node);
+
+        if(literal->isString()) return TypeAnnotation::String;
+        if(literal->isBoolean()) return TypeAnnotation::Boolean;
+        if(literal->isNil()) return TypeAnnotation::None;
+
+        return TypeAnnotation::Number;
+    }
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return staticType(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const TypeAnnotation type = annotationOf(static_cast<VariableExpression*>(node)->name().lexeme);
+        if(type != TypeAnnotation::None) return type;
+
+        return std::nullopt;
+    }
+
+    if(instanceof<Expression, AssignmentExpression>(node)){
+        const auto assignment = static_cast<AssignmentExpression*>(node);
+        const TypeAnnotation type = annotationOf(assignment->name().lexeme);
+
+        if(type != TypeAnnotation::None) return type;
+        return staticType(assignment->value().get());
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+
+        switch(unary->op().type){
+            case TokenType::NotKeyword: return TypeAnnotation::Boolean;
+            case TokenType::Minus: return TypeAnnotation::Number;
+            default: return std::nullopt;
+        }
+    }
+
+    if(!instanceof<Expression, BinaryExpression>(node)){
+        return std::nullopt;
+    }
+
+    const auto binary = static_cast<BinaryExpression*>(node);
+
+    switch(binary->op().type){
+        case TokenType::Less:
+        case TokenType::Greater:
+        case TokenType::LessEqual:
+        case TokenType::GreaterEqual:
+        case TokenType::Equal:
+        case TokenType::NotEqual:
+            return TypeAnnotation::Boolean;
+        case TokenType::Minus:
+        case TokenType::Star:
+        case TokenType::Slash:
+        case TokenType::Exponent:
+            return TypeAnnotation::Number;
+        case TokenType::Plus: {
+            const auto left = staticType(binary->left().get());
+            const auto right = staticType(binary->right().get());
+
+            if(left == TypeAnnotation::Number || right == TypeAnnotation::Number){
+                return TypeAnnotation::Number;
+            }
+
+            if(left == TypeAnnotation::String || right == TypeAnnotation::String){
+                return TypeAnnotation::String;
+            }
+
+            return std::nullopt;
+        }
+        case TokenType::AndKeyword:
+        case TokenType::OrKeyword: {
+            // Either operand can be the result.
+            const auto left = staticType(binary->left().get());
+            const auto right = staticType(binary->right().get());
+
+            return left == right ? left : std::nullopt;
+        }
+        default:
+            return std::nullopt;
+    }
+}
+
+auto Compiler::checkAnnotation(TypeAnnotation type, const Expression* value) -> bool {
+
+    if(type == TypeAnnotation::None) return false;
+
+    const auto known = staticType(value);
+    if(!known.has_value()) return true;
+
+    if(known.value() != type){
+        currentNodeLocation_ = value->location();
+        emitError("Type mismatch, expect a value of type '%s'.", typeName(type));
+    }
+
+    return false;
+}
+
+auto Compiler::emitTypeCheck(TypeAnnotation type, const Expression* value) -> void {
+
+    // Checks the value on top of the stack, unless it is known statically.
+    if(!checkAnnotation(type, value)) return;
+
+    emit(OpCode::CheckType);
+    emit(static_cast<Byte>(type));
+}
+
+auto Compiler::checkArguments(const CallExpression& expr) -> void {
+
+    if(analysis_ == nullptr || !instanceof<Expression, VariableExpression>(expr.callee().get())){
+        return;
+    }
+
+    const auto name = static_cast<VariableExpression*>(expr.callee().get())->name().lexeme;
+
+    const bool shadowed = inline_ != nullptr
+        ? findInlineBinding(name) != nullptr
+        : findLocal(name) != -1;
+
+    const analysis::GlobalInfo* info = analysis_->global(name);
+    if(shadowed || info == nullptr || info->function == nullptr || info->assigned) return;
+
+    // Arguments of a known callee are checked at compile time where
+    // possible, the callee checks the rest on entry.
+    const auto& annotations = info->function->annotations();
+    if(annotations.size() != expr.arguments().size()) return;
+
+    for(std::size_t i = 0; i < annotations.size(); i++){
+        checkAnnotation(annotations[i], expr.arguments()[i].get());
+    }
+}
+
+auto Compiler::isProvenNumber(const Expression* expr) const -> bool {
+
+    if(numericConstant(expr).has_value() || (types_ != nullptr && types_->isNumber(expr))){
+        return true;
+    }
+
+    return instanceof<Expression, VariableExpression>(const_cast<Expression*>(expr)) &&
+           annotationOf(static_cast<const VariableExpression*>(expr)->name().lexeme) == TypeAnnotation::Number;
+}
+
+auto Compiler::isKnownNumber(const Expression* expr) const -> bool {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(numericConstant(expr).has_value()) return true;
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return isKnownNumber(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const auto name = static_cast<VariableExpression*>(node)->name().lexeme;
+
+        // Reading a local cannot fail, so a proven type is a known number.
+        if(findLocal(name) != -1) return isProvenNumber(expr);
+        if(!isConstantGlobal(name)) return false;
+
+        const Expression* initializer = analysis_->global(name)->initializer;
+        return initializer != nullptr && numericConstant(initializer).has_value();
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+
+        return (unary->op().type == TokenType::Minus || unary->op().type == TokenType::Plus) &&
+               isKnownNumber(unary->right().get());
+    }
+
+    if(!instanceof<Expression, BinaryExpression>(node)){
+        return false;
+    }
+
+    const auto binary = static_cast<BinaryExpression*>(node);
+
+    switch(binary->op().type){
+        case TokenType::Plus:
+        case TokenType::Minus:
+        case TokenType::Star:
+        case TokenType::Slash:
+        case TokenType::Exponent:
+            return isKnownNumber(binary->left().get()) && isKnownNumber(binary->right().get());
+        default:
+            return false;
+    }
+}
+
+auto Compiler::cannotFail(const Expression* expr) const -> bool {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(instanceof<Expression, LiteralExpression>(node)) return true;
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return cannotFail(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const auto name = static_cast<VariableExpression*>(node)->name().lexeme;
+        return findLocal(name) != -1 || hoistedGlobals_.count(name) != 0 || isConstantGlobal(name);
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+
+        switch(unary->op().type){
+            case TokenType::NotKeyword:
+            case TokenType::Plus:
+                return cannotFail(unary->right().get());
+            default:
+                return isKnownNumber(unary->right().get());
+        }
+    }
+
+    if(!instanceof<Expression, BinaryExpression>(node)){
+        return false;
+    }
+
+    const auto binary = static_cast<BinaryExpression*>(node);
+
+    switch(binary->op().type){
+        case TokenType::Equal:
+        case TokenType::NotEqual:
+            return cannotFail(binary->left().get()) && cannotFail(binary->right().get());
+        case TokenType::AndKeyword:
+        case TokenType::OrKeyword:
+            return false;
+        default:
+            return isKnownNumber(binary->left().get()) && isKnownNumber(binary->right().get());
+    }
+}
+
+auto Compiler::isWorthHoisting(const Expression* expr) const -> bool {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(hoisted_.count(expr) != 0 || numericConstant(expr).has_value()) return false;
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return isWorthHoisting(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    // Global reads are hash lookups, local reads are already as cheap as
+    // the hoisted value would be.
+    if(instanceof<Expression, VariableExpression>(node)){
+        const auto name = static_cast<VariableExpression*>(node)->name().lexeme;
+        return findLocal(name) == -1 && hoistedGlobals_.count(name) == 0;
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        return static_cast<UnaryExpression*>(node)->op().type != TokenType::Plus;
+    }
+
+    return instanceof<Expression, BinaryExpression>(node);
+}
+
+auto Compiler::collectInvariants(const Expression* expr, const LoopSummary& loop, bool& guaranteed,
+                                 std::vector<const Expression*>& invariants) const -> bool {
+
+    // Returns whether `expr` is invariant. Non-invariant nodes record their
+    // invariant operands; an operand is only hoisted when evaluating it
+    // early cannot raise an error the loop would not have raised first.
+    Expression* node = const_cast<Expression*>(expr);
+
+    const auto consider = [&](const Expression* operand, bool evaluatedFirst) {
+        if(isWorthHoisting(operand) && (evaluatedFirst || cannotFail(operand))){
+            invariants.push_back(operand);
+        }
+    };
+
+    if(hoisted_.count(expr) != 0 || instanceof<Expression, LiteralExpression>(node)){
+        return true;
+    }
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return collectInvariants(static_cast<GroupingExpression*>(node)->expression().get(), loop, guaranteed, invariants);
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const auto name = static_cast<VariableExpression*>(node)->name().lexeme;
+        if(loop.written.count(name) != 0) return false;
+
+        return findLocal(name) != -1 || hoistedGlobals_.count(name) != 0 || isConstantGlobal(name);
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        return collectInvariants(static_cast<UnaryExpression*>(node)->right().get(), loop, guaranteed, invariants);
+    }
+
+    if(instanceof<Expression, BinaryExpression>(node)){
+        const auto binary = static_cast<BinaryExpression*>(node);
+        const auto operatorType = binary->op().type;
+
+        const bool leftFirst = guaranteed;
+        const bool left = collectInvariants(binary->left().get(), loop, guaranteed, invariants);
+
+        if(operatorType == TokenType::AndKeyword || operatorType == TokenType::OrKeyword){
+            if(left) consider(binary->left().get(), leftFirst);
+
+            // The right operand is evaluated conditionally.
+            bool conditional = false;
+            if(collectInvariants(binary->right().get(), loop, conditional, invariants)){
+                consider(binary->right().get(), false);
+            }
+
+            const auto summary = analysis::summarize(*binary->right());
+            if(summary.hasCalls || summary.hasAssignments) guaranteed = false;
+
+            return false;
+        }
+
+        const bool rightFirst = guaranteed;
+        const bool right = collectInvariants(binary->right().get(), loop, guaranteed, invariants);
+
+        if(left && right) return true;
+
+        if(left) consider(binary->left().get(), leftFirst);
+        if(right) consider(binary->right().get(), rightFirst);
+
+        return false;
+    }
+
+    if(instanceof<Expression, CallExpression>(node)){
+        const auto call = static_cast<CallExpression*>(node);
+        const Expression* callee = call->callee().get();
+
+        const bool calleeFirst = guaranteed;
+
+        // Inlined calls never read their callee.
+        bool inlinable = false;
+        if(instanceof<Expression, VariableExpression>(const_cast<Expression*>(callee)) && analysis_ != nullptr){
+            const FunctionInfo* info = analysis_->function(static_cast<const VariableExpression*>(callee)->name().lexeme);
+            inlinable = info != nullptr && info->verdict == analysis::InlineVerdict::Inlinable;
+        }
+
+        if(collectInvariants(callee, loop, guaranteed, invariants) && !inlinable){
+            consider(callee, calleeFirst);
+        }
+
+        for(const auto& arg : call->arguments()){
+            const bool argFirst = guaranteed;
+            if(collectInvariants(arg.get(), loop, guaranteed, invariants)) consider(arg.get(), argFirst);
+        }
+
+        guaranteed = false;
+        return false;
+    }
+
+    if(instanceof<Expression, AssignmentExpression>(node)){
+        const auto assignment = static_cast<AssignmentExpression*>(node);
+
+        const bool valueFirst = guaranteed;
+        if(collectInvariants(assignment->value().get(), loop, guaranteed, invariants)){
+            consider(assignment->value().get(), valueFirst);
+        }
+
+        guaranteed = false;
+        return false;
+    }
+
+    return false;
+}
+
+auto Compiler::hoistInvariants(const WhileStatement& stmt) -> std::vector<const Expression*> {
+
+    std::vector<const Expression*> hoisted;
+
+    if(!options_.optimize || inline_ != nullptr) return hoisted;
+
+    const LoopSummary loop = analysis::summarizeLoop(stmt);
+    std::vector<const Expression*> invariants;
+
+    // Only the condition is certain to run before anything observable; the
+    // body may not run at all, so only expressions that cannot fail move
+    // out of it.
+    for(std::size_t i = 0; i < loop.roots.size(); i++){
+        bool guaranteed = i == 0;
+
+        const Expression* root = loop.roots[i];
+        if(collectInvariants(root, loop, guaranteed, invariants)){
+            if(isWorthHoisting(root) && (i == 0 || cannotFail(root))) invariants.push_back(root);
+        }
+    }
+
+    for(const Expression* invariant : invariants){
+        if(localsCount_ >= MAX_LOCALS) break;
+
+        Expression* node = const_cast<Expression*>(invariant);
+        while(instanceof<Expression, GroupingExpression>(node)){
+            node = static_cast<GroupingExpression*>(node)->expression().get();
+        }
+
+        const bool isGlobal = instanceof<Expression, VariableExpression>(node);
+        const auto name = isGlobal ? static_cast<VariableExpression*>(node)->name().lexeme : std::string_view();
+
+        if(isGlobal && hoistedGlobals_.count(name) != 0) continue;
+
+        compileExpression(invariant);
+
+        const Token hidden { TokenType::Identifier, "$invariant", invariant->location() };
+        const int slot = addLocal(hidden);
+        markVariableAsDefined();
+
+        if(isGlobal){
+            hoistedGlobals_[name] = slot;
+            hoisted.push_back(node);
+        } else {
+            hoisted_[invariant] = slot;
+            hoisted.push_back(invariant);
+        }
+    }
+
+    return hoisted;
+}
+
+auto Compiler::compileInduction(const AssignmentExpression& expr) -> bool {
+
+    // `i = i + c`, `i = c + i` and `i = i - c` on a local become a single
+    // in-place update when the value of the assignment is discarded.
+    if(inline_ != nullptr || !instanceof<Expression, BinaryExpression>(expr.value().get())){
+        return false;
+    }
+
+    const int slot = findLocal(expr.name().lexeme);
+    if(slot == -1 || locals_[slot].depth == -1) return false;
+
+    const auto binary = static_cast<BinaryExpression*>(expr.value().get());
+    const auto operatorType = binary->op().type;
+
+    const auto isTarget = [&](const ExpressionPtr& operand) {
+        return instanceof<Expression, VariableExpression>(operand.get()) &&
+               static_cast<VariableExpression*>(operand.get())->name().lexeme == expr.name().lexeme;
+    };
+
+    std::optional<Value> step;
+
+    if(operatorType == TokenType::Plus){
+        if(isTarget(binary->left())) step = numericConstant(binary->right().get());
+        else if(isTarget(binary->right())) step = numericConstant(binary->left().get());
+    } else if(operatorType == TokenType::Minus && isTarget(binary->left())){
+        step = numericConstant(binary->right().get());
+    }
+
+    if(!step.has_value()) return false;
+
+    emit(operatorType == TokenType::Plus ? OpCode::IncrLocal : OpCode::DecrLocal);
+    emit(static_cast<Byte>(slot));
+    emit(currentChunk().addConstant(step.value()));
+
+    invalidateLocal(slot);
+    return true;
+}
+
+auto Compiler::isCseCandidate(const Expression* expr, std::vector<int>& reads) const -> bool {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(instanceof<Expression, LiteralExpression>(node)) return true;
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return isCseCandidate(static_cast<GroupingExpression*>(node)->expression().get(), reads);
+    }
+
+    if(instanceof<Expression, VariableExpression>(node)){
+        const int slot = findLocal(static_cast<VariableExpression*>(node)->name().lexeme);
+        if(slot == -1 || locals_[slot].depth == -1) return false;
+
+        reads.push_back(slot);
+        return true;
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        return isCseCandidate(static_cast<UnaryExpression*>(node)->right().get(), reads);
+    }
+
+    if(instanceof<Expression, BinaryExpression>(node)){
+        const auto binary = static_cast<BinaryExpression*>(node);
+        const auto operatorType = binary->op().type;
+
+        return operatorType != TokenType::AndKeyword &&
+               operatorType != TokenType::OrKeyword &&
+               isCseCandidate(binary->left().get(), reads) &&
+               isCseCandidate(binary->right().get(), reads);
+    }
+
+    return false;
+}
+
+auto Compiler::sameExpression(const Expression* lhs, const Expression* rhs) const -> bool {
+
+    Expression* left = const_cast<Expression*>(lhs);
+    Expression* right = const_cast<Expression*>(rhs);
+
+    while(instanceof<Expression, GroupingExpression>(left)){
+        left = static_cast<GroupingExpression*>(left)->expression().get();
+    }
+
+    while(instanceof<Expression, GroupingExpression>(right)){
+        right = static_cast<GroupingExpression*>(right)->expression().get();
+    }
+
+    if(instanceof<Expression, LiteralExpression>(left) && instanceof<Expression, LiteralExpression>(right)){
+        const auto a = static_cast<LiteralExpression*>(left);
+        const auto b = static_cast<LiteralExpression*>(right);
+
+        if(a->isInteger() || b->isInteger()){
+            return a->isInteger() && b->isInteger() && a->asInteger() == b->asInteger();
+        }
+
+        if(a->isNumber() && b->isNumber()){
+            return a->asNumber() == b->asNumber() &&
+                   std::signbit(a->asNumber()) == std::signbit(b->asNumber());
+        }
 
-        const char* name = !compilingFunction_.name.empty()
-            ? compilingFunction_.name.c_str()
-            : "<script>";
+        if(a->isString() && b->isString()) return a->asString() == b->asString();
+        if(a->isBoolean() && b->isBoolean()) return a->asBoolean() == b->asBoolean();
 
-        disassembler.disassembleChunk(name, compilingFunction_.chunk);
+        return a->isNil() && b->isNil();
     }
 
-    return compilingFunction_;
-}
+    if(instanceof<Expression, VariableExpression>(left) && instanceof<Expression, VariableExpression>(right)){
+        const int slot = findLocal(static_cast<VariableExpression*>(left)->name().lexeme);
+        return slot != -1 && slot == findLocal(static_cast<VariableExpression*>(right)->name().lexeme);
+    }
 
-auto Compiler::addLocal(const Token& name) -> std::uint8_t {
-    locals_[localsCount_++] = Local { name, -1 };
-    return localsCount_ - 1;
-}
+    if(instanceof<Expression, UnaryExpression>(left) && instanceof<Expression, UnaryExpression>(right)){
+        const auto a = static_cast<UnaryExpression*>(left);
+        const auto b = static_cast<UnaryExpression*>(right);
 
-auto Compiler::declareVariable(const Token& name) -> void {
+        return a->op().type == b->op().type && sameExpression(a->right().get(), b->right().get());
+    }
 
-    if(scopeDepth_ == 0) return;
+    if(instanceof<Expression, BinaryExpression>(left) && instanceof<Expression, BinaryExpression>(right)){
+        const auto a = static_cast<BinaryExpression*>(left);
+        const auto b = static_cast<BinaryExpression*>(right);
 
-    if(localsCount_ > MAX_LOCALS){
-        emitError("Each scope can have maximun 256 locals.");
-        return;
+        return a->op().type == b->op().type &&
+               sameExpression(a->left().get(), b->left().get()) &&
+               sameExpression(a->right().get(), b->right().get());
     }
 
-    const Local* local = nullptr;
-    for(int i = localsCount_ - 1; i >= 0; i--){
-        local = &locals_[i];
-        if(local->depth != -1 && local->depth < scopeDepth_) break;
+    return false;
+}
 
-        if(name.lexeme == local->name.lexeme) {
-            emitError("Variable already declared.");
-            break;
-        }
+auto Compiler::findAvailable(const Expression* expr) const -> int {
+
+    if(!options_.optimize || inline_ != nullptr || available_.empty()) return -1;
+
+    for(const auto& available : available_){
+        if(available.slot < MAX_LOCALS && sameExpression(available.expr, expr)) return available.slot;
     }
 
-    addLocal(name);
+    return -1;
 }
 
-auto Compiler::defineVariable(const Token& name) -> void {
+auto Compiler::makeAvailable(const Expression* expr, int slot) -> void {
 
-    if(scopeDepth_ > 0){
-        markVariableAsDefined();
-        return;
-    }
+    if(!options_.optimize || inline_ != nullptr || numericConstant(expr).has_value()) return;
 
-    Byte index = currentChunk().addConstant(std::string(name.lexeme));
-    emit(OpCode::DefineGlobal);
-    emit(index);
+    // GetLocal only addresses the first MAX_LOCALS slots.
+    if(slot >= MAX_LOCALS) return;
+
+    std::vector<int> reads;
+    if(!isCseCandidate(expr, reads)) return;
+
+    available_.push_back({ expr, slot, availableId_++, std::move(reads) });
 }
 
-auto Compiler::markVariableAsDefined() -> void {
-    locals_[localsCount_ - 1].depth = scopeDepth_;
+auto Compiler::invalidateSlots(int from) -> void {
+
+    // Drops values popped off the stack and expressions over locals that
+    // went out of scope.
+    available_.erase(std::remove_if(available_.begin(), available_.end(), [&](const auto& available) {
+        return available.slot >= from ||
+               std::any_of(available.reads.begin(), available.reads.end(), [&](int read) { return read >= from; });
+    }), available_.end());
 }
 
-auto Compiler::resolveVariableName(const Token& name) -> int {
+auto Compiler::invalidateLocal(int slot) -> void {
 
-    const Local* local = nullptr;
-    for(int i = localsCount_ - 1; i >= 0; i--){
-        local = &locals_[i];
+    available_.erase(std::remove_if(available_.begin(), available_.end(), [&](const auto& available) {
+        return available.slot == slot ||
+               std::find(available.reads.begin(), available.reads.end(), slot) != available.reads.end();
+    }), available_.end());
+}
 
-        if(name.lexeme == local->name.lexeme) {
+auto Compiler::visitVariableDeclaration(const VariableDeclaration& decl) -> void { 
 
-            if(local->depth == -1) {
-                emitError("You can't use a variable in it's own initializer.");
-            }
+    // A global no function refers to lives in a slot of the script frame.
+    // When every read is folded to its value it needs no storage at all.
+    const bool promoted = promotesGlobal(decl);
 
-            return i;
-        }
+    if(promoted && analysis_->global(decl.name().lexeme)->constant &&
+       decl.annotation() == TypeAnnotation::None && isLiteralValue(decl.initializer().get())){
+        return;
     }
 
-    return -1;
-}
+    promoted ? static_cast<void>(addLocal(decl.name())) : declareVariable(decl.name());
 
-auto Compiler::visitVariableDeclaration(const VariableDeclaration& decl) -> void { 
-    declareVariable(decl.name());
+    const bool local = scopeDepth_ > 0 || promoted;
+
+    // A local's initializer is evaluated straight into its slot.
+    if(local) stackDepth_ = -1;
 
     compileExpression(decl.initializer());
-    defineVariable(decl.name());
+    emitTypeCheck(decl.annotation(), decl.initializer().get());
+
+    if(local) locals_[localsCount_ - 1].type = decl.annotation();
+
+    promoted ? markVariableAsDefined() : defineVariable(decl.name());
+
+    stackDepth_ = 0;
 }
 
 auto Compiler::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
@@ -110,14 +1339,31 @@ auto Compiler::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void
         return;
     }
 
-    Compiler compiler(FunctionType::Function, this->reporter_, debugMode_);
+    Compiler compiler(FunctionType::Function, this->reporter_, options_);
     compiler.compilingFunction_.name = decl.name().lexeme;
+    compiler.analysis_ = analysis_;
+    compiler.types_ = types_;
+    compiler.topLevelIndex_ = topLevelIndex_;
+    compiler.evaluator_ = evaluator_;
+    compiler.evaluationBudget_ = evaluationBudget_;
 
     compiler.beginScope();
+    compiler.currentNodeLocation_ = decl.location();
+
+    for(std::size_t i = 0; i < decl.params().size(); i++){
+        compiler.declareVariable(decl.params()[i]);
+        compiler.defineVariable(decl.params()[i]);
+
+        const TypeAnnotation type = decl.annotations()[i];
+        const int slot = compiler.localsCount_ - 1;
 
-    for(const auto& param : decl.params()){
-        compiler.declareVariable(param);
-        compiler.defineVariable(param);
+        compiler.locals_[slot].type = type;
+
+        if(type != TypeAnnotation::None){
+            compiler.emit(OpCode::CheckLocal);
+            compiler.emit(static_cast<Byte>(slot));
+            compiler.emit(static_cast<Byte>(type));
+        }
     }
 
     if(!instanceof<Statement, Block>(decl.body().get())){
@@ -130,6 +1376,35 @@ auto Compiler::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void
 
     function.arity = decl.params().size();
 
+    const FunctionInfo* info = analysis_ != nullptr ? analysis_->function(decl.name().lexeme) : nullptr;
+
+    // Caching needs the purity proof of the whole program, the REPL
+    // compiles `@memo` functions as plain ones.
+    if(decl.memoized() && analysis_ != nullptr){
+        if(info != nullptr && info->pure){
+            function.memo = std::make_shared<MemoCache>();
+        } else {
+            // The range of the declaration ends at the token after it.
+            const SourceRange location = currentNodeLocation_;
+            currentNodeLocation_ = decl.name().position;
+
+            emitError("Can't memoize '%.*s', it is not pure.",
+                      static_cast<int>(decl.name().lexeme.size()), decl.name().lexeme.data());
+
+            currentNodeLocation_ = location;
+        }
+    }
+
+    if(evaluator_ != nullptr && info != nullptr && info->pure &&
+       (reporter_ == nullptr || !reporter_->hadError())){
+        ObjectFunction evaluated = function;
+
+        // Compile-time calls must not count in the statistics of the program.
+        if(evaluated.memo != nullptr) evaluated.memo = std::make_shared<MemoCache>();
+
+        evaluator_->defineGlobal(std::string(decl.name().lexeme), std::move(evaluated));
+    }
+
     emit(OpCode::PushConstant);
 
     Byte index = currentChunk().addConstant(std::move(function));
@@ -163,7 +1438,7 @@ auto Compiler::patchLoopBreaks() -> void {
     while(i < loop_->end){
         if(currentChunk()[i] == BREAK_PLACEHOLDER){
 
-            const Short offset = loop_->end - i;
+            const Short offset = loop_->end - (i + 3);
 
             currentChunk()[i] = OpCode::Jump;
             currentChunk()[i+1] = (offset >> 8) & 0xff;
@@ -201,14 +1476,36 @@ auto Compiler::patchLoopBreaks() -> void {
                     [[fallthrough]];
                 case OpCode::Negate:
                     [[fallthrough]];
+                case OpCode::Dup:
+                    [[fallthrough]];
+                case OpCode::AddNum:
+                    [[fallthrough]];
+                case OpCode::SubNum:
+                    [[fallthrough]];
+                case OpCode::MultNum:
+                    [[fallthrough]];
+                case OpCode::DivNum:
+                    [[fallthrough]];
+                case OpCode::LessNum:
+                    [[fallthrough]];
+                case OpCode::GreaterNum:
+                    [[fallthrough]];
                 case OpCode::Print:
                     i++;
                     break;
                 case OpCode::JumpIfFalse:
                     [[fallthrough]];
+                case OpCode::JumpIfTrue:
+                    [[fallthrough]];
                 case OpCode::Jump:
                     [[fallthrough]];
                 case OpCode::Loop:
+                    [[fallthrough]];
+                case OpCode::IncrLocal:
+                    [[fallthrough]];
+                case OpCode::DecrLocal:
+                    [[fallthrough]];
+                case OpCode::CheckLocal:
                     i += 3;
                     break;
                 case OpCode::PushConstant:
@@ -224,8 +1521,17 @@ auto Compiler::patchLoopBreaks() -> void {
                 case OpCode::SetGlobal:
                     [[fallthrough]];
                 case OpCode::Call:
+                    [[fallthrough]];
+                case OpCode::CheckType:
+                    [[fallthrough]];
+                case OpCode::JumpTable:
                     i += 2;
                     break;
+                case OpCode::ForPrep:
+                    [[fallthrough]];
+                case OpCode::ForLoop:
+                    i += 4;
+                    break;
                 default:
                     i++;
                     break;
@@ -243,8 +1549,6 @@ auto Compiler::endLoop() -> void {
 }
 
 auto Compiler::emitLoop(int start) -> void {
- 
-    loop_->end = currentChunk().size();
 
     emit(OpCode::Loop);
     const int offset = currentChunk().size() - start + 2;
@@ -254,52 +1558,277 @@ auto Compiler::emitLoop(int start) -> void {
         return;
     }
         
-    currentChunk().write((offset >> 8) & 0xff, currentNodeLocation_.start.line);
-    currentChunk().write(offset & 0xff, currentNodeLocation_.start.line);
+    currentChunk().write((offset >> 8) & 0xff, currentNodeLocation_.start.offset);
+    currentChunk().write(offset & 0xff, currentNodeLocation_.start.offset);
 }
 
 auto Compiler::visitWhileStatement(const WhileStatement& stmt) -> void {
 
+    // Hoisted invariants live in hidden locals of a scope around the loop.
+    beginScope();
+
+    const auto invariants = hoistInvariants(stmt);
+
     Loop loop;
     beginLoop(&loop);
 
+    // The loop header and body start new basic blocks.
+    available_.clear();
+
     compileExpression(stmt.condition());
 
     const int exitJump = emitJump(OpCode::JumpIfFalse);
     emit(OpCode::Pop);
 
+    available_.clear();
     compileStatement(stmt.body());
 
     emitLoop(loop.start);
 
     patchJump(exitJump);
+    emit(OpCode::Pop);
+
+    available_.clear();
+
+    // `break` leaves the loop after the condition has been popped.
+    loop.end = currentChunk().size();
     endLoop();
 
-    emit(OpCode::Pop);
+    for(const Expression* invariant : invariants){
+        hoisted_.erase(invariant);
+
+        if(instanceof<Expression, VariableExpression>(const_cast<Expression*>(invariant))){
+            hoistedGlobals_.erase(static_cast<const VariableExpression*>(invariant)->name().lexeme);
+        }
+    }
+
+    endScope();
+}
+
+auto Compiler::visitForStatement(const ForStatement& stmt) -> void {
+
+    if(localsCount_ + 4 > MAX_LOCALS){
+        emitError("Each scope can have maximun 256 locals.");
+        return;
+    }
+
+    // Counter, limit and step live in hidden locals below the loop
+    // variable, ForLoop updates the counter and the variable in place.
+    beginScope();
+
+    const Token hidden { TokenType::Identifier, "$for", stmt.location() };
+    const int control = localsCount_;
+
+    compileExpression(stmt.start());
+    addLocal(hidden);
+    markVariableAsDefined();
+
+    compileExpression(stmt.limit());
+    addLocal(hidden);
+    markVariableAsDefined();
+
+    if(stmt.haveStep()){
+        // Literal steps only, a folded constant global would turn the
+        // runtime error into a compile error with optimizations only.
+        const auto step = numericConstant(stmt.step().get());
+        if(step.has_value() && step->asNumber() == 0 && !analysis::summarize(*stmt.step()).hasNames){
+            emitError("Expect a non-zero 'for' step.");
+        }
+
+        compileExpression(stmt.step());
+    } else {
+        emitConstant(Value(std::int64_t(1)));
+    }
+
+    addLocal(hidden);
+    markVariableAsDefined();
+
+    emit(OpCode::ForPrep);
+    emit(static_cast<Byte>(control));
+    const int exitJump = currentChunk().size();
+    emit(Byte(0xff));
+    emit(Byte(0xff));
+
+    // ForPrep pushes the first value of the loop variable.
+    addLocal(stmt.variable());
+    markVariableAsDefined();
+
+    Loop loop;
+    loop.counted = true;
+    beginLoop(&loop);
+
+    available_.clear();
+    compileStatement(stmt.body());
+
+    for(const int jump : loop.continues){
+        patchJump(jump);
+    }
+
+    emit(OpCode::ForLoop);
+    emit(static_cast<Byte>(control));
+
+    const int offset = currentChunk().size() - loop.start + 2;
+    if(offset > UINT16_MAX){
+        emitError("Loop body too large.");
+    }
+
+    emit(static_cast<Byte>((offset >> 8) & 0xff));
+    emit(static_cast<Byte>(offset & 0xff));
+
+    patchJump(exitJump);
+    available_.clear();
+
+    loop.end = currentChunk().size();
+    endLoop();
+
+    endScope();
+}
+
+auto Compiler::isHotThenBranch(const IfStatement& stmt) const -> bool {
+
+    if(!options_.optimize || options_.profile == nullptr) return false;
+
+    const auto site = options_.sources->decode(stmt.condition()->location().end);
+    const auto counts = options_.profile->branch(site.line, site.column);
+
+    return counts != nullptr && counts->whenTrue > counts->whenFalse;
 }
 
 auto Compiler::visitIfStatement(const IfStatement& stmt) -> void { 
 
     compileExpression(stmt.condition());
-    
-    const int thenJump = emitJump(OpCode::JumpIfFalse);
+
+    // The branch laid out second is reached by the conditional jump and
+    // needs no jump over the other one. That is the else branch, unless
+    // earlier runs mostly took the then branch.
+    const bool thenLast = isHotThenBranch(stmt);
+
+    const StatementPtr* first = &stmt.thenBranch();
+    const StatementPtr* second = stmt.haveElseBranch() ? &stmt.elseBranch() : nullptr;
+
+    if(thenLast) std::swap(first, second);
+
+    const int branchJump = emitJump(thenLast ? OpCode::JumpIfTrue : OpCode::JumpIfFalse);
+
+    // The end of the condition, where the then branch opens, identifies
+    // the `if` in the profile.
+    if(options_.recordBranches){
+        const auto site = options_.sources->decode(stmt.condition()->location().end);
+        currentChunk().addBranchSite(branchJump - 1, { site.line, site.column });
+    }
+
     emit(OpCode::Pop);
 
-    compileStatement(stmt.thenBranch());
+    available_.clear();
+    if(first != nullptr) compileStatement(*first);
 
-    const int elseJump = emitJump(OpCode::Jump);
+    const int exitJump = emitJump(OpCode::Jump);
 
-    patchJump(thenJump);
+    patchJump(branchJump);
     emit(OpCode::Pop);
 
+    available_.clear();
+    if(second != nullptr) compileStatement(*second);
+
+    patchJump(exitJump);
+    available_.clear();
+}
+
+auto Compiler::visitMatchStatement(const MatchStatement& stmt) -> void {
+
+    compileExpression(stmt.subject());
+
+    const std::size_t index = currentChunk().addCaseTable(CaseTable());
+    if(index > UINT8_MAX){
+        emitError("Too many match statements in one function.");
+        return;
+    }
+
+    emit(OpCode::JumpTable);
+    emit(static_cast<Byte>(index));
+
+    // The else arm, or nothing, follows the instruction; the other arms
+    // come after it in source order.
+    const std::size_t base = currentChunk().size();
+    std::vector<int> exits;
+
+    available_.clear();
     if(stmt.haveElseBranch()){
         compileStatement(stmt.elseBranch());
     }
 
-    patchJump(elseJump);
+    std::vector<std::size_t> targets;
+
+    for(std::size_t i = 0; i < stmt.arms().size(); i++){
+        exits.push_back(emitJump(OpCode::Jump));
+        targets.push_back(currentChunk().size() - base);
+
+        available_.clear();
+        compileStatement(stmt.arms()[i].body);
+    }
+
+    for(const int exit : exits){
+        patchJump(exit);
+    }
+
+    available_.clear();
+
+    if(currentChunk().size() - base > UINT16_MAX){
+        emitError("Too long jump.");
+        return;
+    }
+
+    CaseTable table;
+
+    for(std::size_t i = 0; i < stmt.arms().size(); i++){
+        const auto target = static_cast<std::uint16_t>(targets[i]);
+
+        for(const auto& label : stmt.arms()[i].labels){
+            const auto literal = static_cast<const LiteralExpression*>(label.get());
+
+            const bool duplicate = literal->isString()
+                ? !table.strings.emplace(literal->asString(), target).second
+                : !table.integers.emplace(literal->asInteger(), target).second;
+
+            if(duplicate){
+                currentNodeLocation_ = label->location();
+                emitError("Duplicate 'match' case.");
+            }
+        }
+    }
+
+    packCaseTable(table);
+    currentChunk().getCaseTable(index) = std::move(table);
+}
+
+auto packCaseTable(CaseTable& table) -> void {
+
+    // Integer cases filling at least half of their range get a dense
+    // table, the hashed lookup is left for sparse ones.
+    if(table.integers.empty()) return;
+
+    const auto [low, high] = std::minmax_element(table.integers.begin(), table.integers.end());
+    const std::uint64_t distance = static_cast<std::uint64_t>(high->first) - static_cast<std::uint64_t>(low->first);
+
+    if(distance < Compiler::MAX_DENSE_CASES && distance < 2 * table.integers.size()){
+        table.low = low->first;
+        table.dense.assign(distance + 1, 0);
+
+        for(const auto& [key, target] : table.integers){
+            table.dense[static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(table.low)] = target;
+        }
+
+        table.integers.clear();
+    }
 }
 
 auto Compiler::visitExpressionStatement(const ExpressionStatement& stmt) -> void { 
+
+    if(options_.optimize && instanceof<Expression, AssignmentExpression>(stmt.expression().get())){
+        const auto assignment = static_cast<AssignmentExpression*>(stmt.expression().get());
+        if(compileInduction(*assignment)) return;
+    }
+
     compileExpression(stmt.expression());
     emit(OpCode::Pop);
 }
@@ -314,6 +1843,11 @@ auto Compiler::visitContinueStatement([[maybe_unused]] const ContinueStatement&
         emit(OpCode::Pop);
     }
 
+    if(loop_->counted){
+        loop_->continues.push_back(emitJump(OpCode::Jump));
+        return;
+    }
+
     emitLoop(loop_->start);
 }
 
@@ -354,14 +1888,17 @@ auto Compiler::visitPrintStatement(const PrintStatement& stmt) -> void {
 auto Compiler::visitAssignmentExpression(const AssignmentExpression& expr) -> void { 
 
     compileExpression(expr.value());
+    emitTypeCheck(annotationOf(expr.name().lexeme), expr.value().get());
     
     int index = resolveVariableName(expr.name());
 
     if(index == -1){
         index = currentChunk().addConstant(std::string(expr.name().lexeme));
         emit(OpCode::SetGlobal);
+        available_.clear();
     } else {
         emit(OpCode::SetLocal);
+        invalidateLocal(index);
     }
 
     emit(static_cast<Byte>(index));
@@ -371,6 +1908,15 @@ auto Compiler::visitBinaryExpression(const BinaryExpression& expr) -> void {
 
     const TokenType operatorType = expr.op().type;
 
+    const int slot = localsCount_ + stackDepth_;
+
+    // Values computed by the right operand only exist on one path.
+    const auto dropConditional = [&](std::uint32_t firstId) {
+        available_.erase(std::remove_if(available_.begin(), available_.end(), [&](const auto& available) {
+            return available.id >= firstId;
+        }), available_.end());
+    };
+
     if(operatorType == TokenType::AndKeyword){
 
         compileExpression(expr.left());
@@ -378,9 +1924,13 @@ auto Compiler::visitBinaryExpression(const BinaryExpression& expr) -> void {
         const int jump = emitJump(OpCode::JumpIfFalse);
         emit(OpCode::Pop);
 
+        invalidateSlots(slot);
+        const std::uint32_t firstId = availableId_;
+
         compileExpression(expr.right());
         patchJump(jump);
 
+        dropConditional(firstId);
         return;
     }
 
@@ -392,44 +1942,71 @@ auto Compiler::visitBinaryExpression(const BinaryExpression& expr) -> void {
 
         patchJump(elseJump);
         emit(OpCode::Pop);
+
+        invalidateSlots(slot);
+        const std::uint32_t firstId = availableId_;
+
         compileExpression(expr.right());
 
         patchJump(endJump);
 
+        dropConditional(firstId);
+        return;
+    }
+
+    const int available = findAvailable(&expr);
+
+    if(available != -1){
+        emit(OpCode::GetLocal);
+        emit(static_cast<Byte>(available));
+        return;
+    }
+
+    if(options_.optimize && simplifyBinaryExpression(expr)){
+        invalidateSlots(slot);
+        makeAvailable(&expr, slot);
         return;
     }
 
     compileExpression(expr.left());
+    stackDepth_++;
     compileExpression(expr.right());
+    stackDepth_--;
+
+    invalidateSlots(slot);
+    makeAvailable(&expr, slot);
+
+    // Operands proven to be numbers skip the VM's type checks.
+    const bool numeric = isProvenNumber(expr.left().get()) && isProvenNumber(expr.right().get());
 
     switch(operatorType){
         case TokenType::Minus:
-            emit(OpCode::Sub);
+            emit(numeric ? OpCode::SubNum : OpCode::Sub);
             break;
         case TokenType::Plus:
-            emit(OpCode::Add);
+            emit(numeric ? OpCode::AddNum : OpCode::Add);
             break;
         case TokenType::Star:
-            emit(OpCode::Mult);
+            emit(numeric ? OpCode::MultNum : OpCode::Mult);
             break;
         case TokenType::Slash:
-            emit(OpCode::Div);
+            emit(numeric ? OpCode::DivNum : OpCode::Div);
             break;
         case TokenType::Exponent:
             emit(OpCode::Pow);
             break;
         case TokenType::Less:
-            emit(OpCode::Less);
+            emit(numeric ? OpCode::LessNum : OpCode::Less);
             break;
         case TokenType::Greater:
-            emit(OpCode::Greater);
+            emit(numeric ? OpCode::GreaterNum : OpCode::Greater);
             break;
         case TokenType::LessEqual:
-            emit(OpCode::Greater);
+            emit(numeric ? OpCode::GreaterNum : OpCode::Greater);
             emit(OpCode::Not);
             break;
         case TokenType::GreaterEqual:
-            emit(OpCode::Less);
+            emit(numeric ? OpCode::LessNum : OpCode::Less);
             emit(OpCode::Not);
             break;
         case TokenType::Equal:
@@ -446,6 +2023,25 @@ auto Compiler::visitBinaryExpression(const BinaryExpression& expr) -> void {
 }
 
 auto Compiler::visitUnaryExpression(const UnaryExpression& expr) -> void { 
+
+    if(options_.optimize && expr.op().type == TokenType::Minus){
+        const auto folded = numericConstant(&expr);
+
+        if(folded.has_value()){
+            emitConstant(folded.value());
+            return;
+        }
+    }
+
+    const int slot = localsCount_ + stackDepth_;
+    const int available = findAvailable(&expr);
+
+    if(available != -1){
+        emit(OpCode::GetLocal);
+        emit(static_cast<Byte>(available));
+        return;
+    }
+
     compileExpression(expr.right());
 
     switch(expr.op().type){
@@ -462,18 +2058,46 @@ auto Compiler::visitUnaryExpression(const UnaryExpression& expr) -> void {
             break;
     }
 
+    invalidateSlots(slot);
+    makeAvailable(&expr, slot);
+
 }
 
 auto Compiler::visitCallExpression(const CallExpression& expr) -> void {
 
+    checkArguments(expr);
+
+    if(const auto value = evaluateCall(expr)){
+        if(value->isBoolean()){
+            emit(value->asBoolean() ? OpCode::True : OpCode::False);
+        } else if(value->isNil()){
+            emit(OpCode::Nil);
+        } else {
+            emitConstant(value.value());
+        }
+
+        return;
+    }
+
+    if(inlineCall(expr)){
+        available_.clear();
+        return;
+    }
+
     compileExpression(expr.callee());
+    stackDepth_++;
 
     for(const auto& arg :  expr.arguments()){
         compileExpression(arg);
+        stackDepth_++;
     }
 
+    stackDepth_ -= expr.arguments().size() + 1;
+
     emit(OpCode::Call);
     emit(static_cast<Byte>(expr.arguments().size()));
+
+    available_.clear();
 }
 
 auto Compiler::visitGroupingExpression(const GroupingExpression& expr) -> void { 
@@ -482,8 +2106,33 @@ auto Compiler::visitGroupingExpression(const GroupingExpression& expr) -> void {
 
 auto Compiler::visitVariableExpression(const VariableExpression& expr) -> void { 
 
+    if(inline_ != nullptr){
+        const InlineBinding* binding = findInlineBinding(expr.name().lexeme);
+
+        if(binding != nullptr && binding->argument != nullptr){
+            InlineFrame* frame = inline_;
+
+            inline_ = frame->enclosing;
+            compileExpression(binding->argument);
+            inline_ = frame;
+
+            return;
+        }
+    }
+
+    if(const Expression* value = constantGlobal(expr.name().lexeme)){
+        const auto number = numericConstant(value);
+        number.has_value() ? emitConstant(number.value()) : const_cast<Expression*>(value)->accept(*this);
+        return;
+    }
+
     int index = resolveVariableName(expr.name());
 
+    if(index == -1 && !hoistedGlobals_.empty()){
+        const auto hoisted = hoistedGlobals_.find(expr.name().lexeme);
+        if(hoisted != hoistedGlobals_.end()) index = hoisted->second;
+    }
+
     if(index == -1){
         index = currentChunk().addConstant(std::string(expr.name().lexeme));
         emit(OpCode::GetGlobal);
@@ -500,13 +2149,13 @@ auto Compiler::visitLiteralExpression(const LiteralExpression& expr) -> void {
 
     if(expr.isBoolean()){
         emit(expr.asBoolean() ? OpCode::True : OpCode::False);
+    } else if(expr.isInteger()){
+        emitConstant(expr.asInteger());
     } else if(expr.isNumber()){
-        emit(OpCode::PushConstant);
-        index = currentChunk().addConstant(expr.asNumber());
-        emit(index);
+        emitConstant(expr.asNumber());
     } else if(expr.isString()){
         emit(OpCode::PushConstant);
-        index = currentChunk().addConstant(expr.asString());
+        index = currentChunk().addConstant(std::string(expr.asString()));
         emit(index);
     } else if(expr.isNil()){
         emit(OpCode::Nil);
@@ -1,12 +1,14 @@
 #include "../include/disassembler.h"
 
+#include <iterator>
+
 namespace scriptlang::disassembler {
 
 
 using scriptlang::runtime::OpCode;
 using scriptlang::runtime::Byte;
 
-auto Disassembler::disassembleChunk(const char* name, Chunk& chunk) -> void {
+auto Disassembler::disassembleChunk(const char* name, const Chunk& chunk) -> void {
     std::uint32_t offset = 0;
 
     stream_ << "======= " << name << " =======\n";
@@ -17,7 +19,7 @@ auto Disassembler::disassembleChunk(const char* name, Chunk& chunk) -> void {
     stream_ << "======= end " << name << " =======\n";
 }
 
-auto Disassembler::disassembleInstruction(Chunk& chunk, int offset) -> int {
+auto Disassembler::disassembleInstruction(const Chunk& chunk, int offset) -> int {
     
     const OpCode opcode = static_cast<OpCode>(chunk[offset]);
 
@@ -52,6 +54,8 @@ auto Disassembler::disassembleInstruction(Chunk& chunk, int offset) -> int {
             return simpleInstruction("OpCode::Print", offset);
         case OpCode::JumpIfFalse:
             return jumpInstruction("OpCode::JumpIfFalse", chunk, 1, offset);
+        case OpCode::JumpIfTrue:
+            return jumpInstruction("OpCode::JumpIfTrue", chunk, 1, offset);
         case OpCode::Jump:
             return jumpInstruction("OpCode::Jump", chunk, 1, offset);
         case OpCode::Loop:
@@ -76,6 +80,34 @@ auto Disassembler::disassembleInstruction(Chunk& chunk, int offset) -> int {
             return simpleInstruction("OpCode::False", offset);
         case OpCode::Nil:
             return simpleInstruction("OpCode::Nil", offset);
+        case OpCode::Dup:
+            return simpleInstruction("OpCode::Dup", offset);
+        case OpCode::IncrLocal:
+            return localConstantInstruction("OpCode::IncrLocal", chunk, offset);
+        case OpCode::DecrLocal:
+            return localConstantInstruction("OpCode::DecrLocal", chunk, offset);
+        case OpCode::AddNum:
+            return simpleInstruction("OpCode::AddNum", offset);
+        case OpCode::SubNum:
+            return simpleInstruction("OpCode::SubNum", offset);
+        case OpCode::MultNum:
+            return simpleInstruction("OpCode::MultNum", offset);
+        case OpCode::DivNum:
+            return simpleInstruction("OpCode::DivNum", offset);
+        case OpCode::LessNum:
+            return simpleInstruction("OpCode::LessNum", offset);
+        case OpCode::GreaterNum:
+            return simpleInstruction("OpCode::GreaterNum", offset);
+        case OpCode::CheckType:
+            return checkInstruction("OpCode::CheckType", chunk, false, offset);
+        case OpCode::CheckLocal:
+            return checkInstruction("OpCode::CheckLocal", chunk, true, offset);
+        case OpCode::ForPrep:
+            return forInstruction("OpCode::ForPrep", chunk, 1, offset);
+        case OpCode::ForLoop:
+            return forInstruction("OpCode::ForLoop", chunk, -1, offset);
+        case OpCode::JumpTable:
+            return jumpTableInstruction("OpCode::JumpTable", chunk, offset);
         default:
             stream_ << "Unknown opcode '" << opcode << "'.\n";
             break;
@@ -89,21 +121,57 @@ auto Disassembler::simpleInstruction(const char* name, int offset) -> int {
     return offset + 1;
 }
 
-auto Disassembler::byteInstruction(const char* name, Chunk& chunk, int offset) -> int {
+auto Disassembler::byteInstruction(const char* name, const Chunk& chunk, int offset) -> int {
     const int byte = chunk[offset + 1];
     stream_ << name << '\t' << byte << '\n';
 
     return offset + 2;
 }
 
-auto Disassembler::jumpInstruction(const char* name, Chunk& chunk, int sign, int offset) -> int {
+auto Disassembler::jumpInstruction(const char* name, const Chunk& chunk, int sign, int offset) -> int {
     
     std::uint16_t jump = static_cast<std::uint16_t>((chunk[offset + 1] << 8) | chunk[offset + 2]);
     stream_ << name << '\t' << offset << " -> " << (offset + 3) + (sign*jump) << '\n';
 
     return offset + 3;
 }
-auto Disassembler::constantInstruction(const char* name, Chunk& chunk, int offset) -> int {
+
+auto Disassembler::forInstruction(const char* name, const Chunk& chunk, int sign, int offset) -> int {
+
+    const int slot = chunk[offset + 1];
+    std::uint16_t jump = static_cast<std::uint16_t>((chunk[offset + 2] << 8) | chunk[offset + 3]);
+    stream_ << name << '\t' << slot << '\t' << offset << " -> " << (offset + 4) + (sign*jump) << '\n';
+
+    return offset + 4;
+}
+
+auto Disassembler::jumpTableInstruction(const char* name, const Chunk& chunk, int offset) -> int {
+
+    const int index = chunk[offset + 1];
+    const auto& table = chunk.getCaseTable(index);
+    const int next = offset + 2;
+
+    stream_ << name << '\t' << index << '\n';
+
+    for(std::size_t i = 0; i < table.dense.size(); i++){
+        if(table.dense[i] == 0) continue;
+        stream_ << "\t|\t" << table.low + static_cast<std::int64_t>(i) << " -> " << next + table.dense[i] << '\n';
+    }
+
+    for(const auto& [key, jump] : table.integers){
+        stream_ << "\t|\t" << key << " -> " << next + jump << '\n';
+    }
+
+    for(const auto& [key, jump] : table.strings){
+        stream_ << "\t|\t\"" << key << "\" -> " << next + jump << '\n';
+    }
+
+    stream_ << "\t|\telse -> " << next << '\n';
+
+    return next;
+}
+
+auto Disassembler::constantInstruction(const char* name, const Chunk& chunk, int offset) -> int {
 
     const std::uint32_t index = chunk[offset + 1];
 
@@ -111,5 +179,30 @@ auto Disassembler::constantInstruction(const char* name, Chunk& chunk, int offse
     return offset + 2;
 }
 
+auto Disassembler::localConstantInstruction(const char* name, const Chunk& chunk, int offset) -> int {
+
+    const int slot = chunk[offset + 1];
+    const std::uint32_t index = chunk[offset + 2];
+
+    stream_ << name << '\t' << slot << "\tIndex: " << index << " (" << chunk.getConstant(index) << ')' << '\n';
+    return offset + 3;
+}
+
+auto Disassembler::checkInstruction(const char* name, const Chunk& chunk, bool local, int offset) -> int {
+
+    static constexpr const char* typeNames[] = { "?", "num", "str", "bool" };
+
+    stream_ << name << '\t';
+
+    if(local){
+        stream_ << static_cast<int>(chunk[++offset]) << '\t';
+    }
+
+    const Byte type = chunk[++offset];
+    stream_ << (type < std::size(typeNames) ? typeNames[type] : "?") << '\n';
+
+    return offset + 1;
+}
+
 
 }
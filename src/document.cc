@@ -0,0 +1,163 @@
+#include "../include/document.h"
+#include "../include/parser.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace scriptlang::parser {
+
+Document::Document(std::string text)
+    : text_(std::move(text)) {
+    reparse(0, 0, 0, 0);
+}
+
+auto Document::edit(std::uint32_t offset, std::uint32_t length, std::string_view text) -> std::size_t {
+
+    text_.replace(offset, length, text);
+
+    // The first declaration that may parse differently: its text or the
+    // token it read ahead reaches the edit, a token ending right at it may
+    // be extended.
+    std::size_t first = 0;
+    std::uint32_t start = 0;
+
+    while(first < segments_.size() && start + segments_[first].text->size() < offset){
+        start += segments_[first].length;
+        first++;
+    }
+
+    return reparse(first, start, offset + length, static_cast<std::int64_t>(text.size()) - length);
+}
+
+auto Document::reparse(std::size_t first, std::uint32_t start,
+                       std::uint32_t editEnd, std::int64_t delta) -> std::size_t {
+
+    const std::string_view text(text_);
+
+    // Only finds where the declarations end, each segment is parsed again
+    // from its own copy of the text.
+    Parser parser(SourceBuffer { text.substr(start), start });
+
+    std::vector<Segment> parsed;
+    std::uint32_t position = start;
+
+    // Old segments from `next` on may still be kept, `oldEnd` is where the
+    // ones before it ended in the old text.
+    std::size_t next = first;
+    std::uint32_t oldEnd = start;
+    bool resynced = false;
+
+    while(!parser.parseDeclarations(1).statements.empty()){
+
+        const std::uint32_t end = parser.parsedEnd().offset;
+        const std::uint32_t lookahead = parser.lookaheadEnd().offset;
+
+        parsed.push_back(parseSegment(text.substr(position, lookahead - position), end - position));
+        position = end;
+
+        // Only the ends after the edited range moved by `delta`, the ones
+        // before it are never met again.
+        while(next < segments_.size()){
+            const std::uint32_t boundary = oldEnd + segments_[next].length;
+
+            if(boundary >= editEnd && boundary + delta >= position) break;
+
+            oldEnd = boundary;
+            next++;
+        }
+
+        if(next < segments_.size() && oldEnd + segments_[next].length + delta == position){
+            resynced = true;
+            next++;
+            break;
+        }
+    }
+
+    // Replaced up to the segment the parse met again, or to the end. Most
+    // edits replace as many segments as they parse, the ones after are not
+    // moved then.
+    const std::size_t last = resynced ? next : segments_.size();
+    const std::size_t count = parsed.size();
+    const std::size_t kept = std::min(count, last - first);
+
+    std::move(parsed.begin(), parsed.begin() + kept, segments_.begin() + first);
+
+    if(kept < count){
+        segments_.insert(segments_.begin() + last,
+                         std::make_move_iterator(parsed.begin() + kept),
+                         std::make_move_iterator(parsed.end()));
+    } else {
+        segments_.erase(segments_.begin() + first + kept, segments_.begin() + last);
+    }
+
+    return count;
+}
+
+auto Document::parseSegment(std::string_view text, std::uint32_t length) -> Segment {
+
+    Segment segment;
+    segment.text = std::make_unique<std::string>(text);
+    segment.length = length;
+
+    const std::string_view source(*segment.text);
+
+    RecordingErrorReporter reporter;
+    Parser parser(SourceBuffer { source, 0 }, &reporter);
+
+    segment.program = parser.parseDeclarations(1);
+
+    // Placed at the end of their range, as BasicErrorReporter does.
+    for(const auto& entry : reporter.entries()){
+        const std::string_view before = source.substr(0, entry.location.end.offset);
+        const std::size_t newline = before.rfind('\n');
+
+        segment.errors.push_back(Diagnostic {
+            static_cast<std::uint32_t>(std::count(before.begin(), before.end(), '\n')) + 1,
+            static_cast<std::uint32_t>(newline != std::string_view::npos
+                ? before.size() - newline
+                : before.size() + 1),
+            entry.message
+        });
+    }
+
+    const std::string_view own = source.substr(0, length);
+    const std::size_t newline = own.rfind('\n');
+
+    segment.newlines = static_cast<std::uint32_t>(std::count(own.begin(), own.end(), '\n'));
+    segment.lastLine = static_cast<std::uint32_t>(newline != std::string_view::npos
+        ? own.size() - newline - 1
+        : own.size());
+
+    return segment;
+}
+
+auto Document::diagnostics() const -> std::vector<Diagnostic> {
+
+    std::vector<Diagnostic> diagnostics;
+
+    // Where the current segment starts.
+    std::uint32_t line = 1;
+    std::uint32_t column = 1;
+
+    for(const Segment& segment : segments_){
+        for(const Diagnostic& error : segment.errors){
+            diagnostics.push_back(Diagnostic {
+                line + error.line - 1,
+                error.line == 1 ? column + error.column - 1 : error.column,
+                error.message
+            });
+        }
+
+        if(segment.newlines > 0){
+            line += segment.newlines;
+            column = segment.lastLine + 1;
+        } else {
+            column += segment.lastLine;
+        }
+    }
+
+    return diagnostics;
+}
+
+}
@@ -6,15 +6,20 @@
 
 namespace scriptlang::error {
 
+auto RecordingErrorReporter::error(const std::string& message, SourceRange location) -> void {
+    entries_.push_back(Entry { message, location });
+}
+
 auto BasicErrorReporter::error(const std::string& message, SourceRange location) -> void {
 
-    const auto& [start, end] = location;
+    const auto start = sources_.decode(location.start);
+    const auto end = sources_.decode(location.end);
 
     std::stringstream sstream;
 
     auto linesCount = (end.line - start.line) + 1;
-    auto sourceStart = start.source.begin() + start.offset;
-    auto sourceEnd = end.source.begin() + end.offset;
+    auto sourceStart = start.text.begin() + start.offset;
+    auto sourceEnd = end.text.begin() + end.offset;
 
     sstream << "[Ln: " << end.line << ", Col: " << end.column << "] Error: " << message << '\n';
 
@@ -0,0 +1,174 @@
+#include "../include/ir.h"
+#include "../include/ast.h"
+
+#include <algorithm>
+
+namespace scriptlang::ir {
+
+auto Instruction::hasResult() const -> bool {
+    switch(op){
+        case Op::SetGlobal:
+        case Op::DefineGlobal:
+        case Op::Print:
+        case Op::Jump:
+        case Op::Branch:
+        case Op::Return:
+            return false;
+        default:
+            return true;
+    }
+}
+
+auto Instruction::isTerminator() const -> bool {
+    return op == Op::Jump || op == Op::Branch || op == Op::Return;
+}
+
+auto Instruction::addOperand(Instruction* value) -> void {
+    operands.push_back(value);
+    value->users.push_back(this);
+}
+
+auto Instruction::replaceAllUsesWith(Instruction* value) -> void {
+
+    for(Instruction* user : users){
+        if(user == this) continue;
+
+        for(auto& operand : user->operands){
+            if(operand == this) operand = value;
+        }
+
+        value->users.push_back(user);
+    }
+
+    users.clear();
+}
+
+auto Instruction::removeUser(Instruction* user) -> void {
+    const auto it = std::find(users.begin(), users.end(), user);
+    if(it != users.end()) users.erase(it);
+}
+
+auto BasicBlock::terminator() const -> Instruction* {
+    if(instructions.empty() || !instructions.back()->isTerminator()) return nullptr;
+    return instructions.back().get();
+}
+
+auto opName(Op op) -> const char* {
+    switch(op){
+        case Op::Constant: return "const";
+        case Op::Parameter: return "param";
+        case Op::Function: return "function";
+        case Op::Phi: return "phi";
+        case Op::Add: return "add";
+        case Op::Sub: return "sub";
+        case Op::Mult: return "mult";
+        case Op::Div: return "div";
+        case Op::Pow: return "pow";
+        case Op::Less: return "less";
+        case Op::Greater: return "greater";
+        case Op::Equal: return "equal";
+        case Op::Not: return "not";
+        case Op::Negate: return "negate";
+        case Op::Check: return "check";
+        case Op::GetGlobal: return "get_global";
+        case Op::SetGlobal: return "set_global";
+        case Op::DefineGlobal: return "define_global";
+        case Op::Call: return "call";
+        case Op::Print: return "print";
+        case Op::Jump: return "jump";
+        case Op::Branch: return "branch";
+        case Op::Return: return "return";
+    }
+
+    return "unknown";
+}
+
+static auto printInstruction(std::ostream& stream, const Instruction& instr) -> void {
+
+    stream << "    ";
+
+    if(instr.hasResult()){
+        stream << '%' << instr.id << " = ";
+    }
+
+    stream << opName(instr.op);
+
+    switch(instr.op){
+        case Op::Constant:
+            stream << ' ' << instr.constant;
+            break;
+        case Op::Parameter:
+        case Op::Function:
+            stream << ' ' << instr.index;
+            break;
+        case Op::Check:
+            stream << ' ' << ast::typeName(static_cast<ast::TypeAnnotation>(instr.index));
+            break;
+        case Op::GetGlobal:
+        case Op::SetGlobal:
+        case Op::DefineGlobal:
+            stream << " '" << instr.name << '\'';
+            break;
+        default:
+            break;
+    }
+
+    for(std::size_t i = 0; i < instr.operands.size(); i++){
+        stream << (i == 0 && !(instr.op == Op::SetGlobal || instr.op == Op::DefineGlobal) ? " " : ", ");
+        stream << '%' << instr.operands[i]->id;
+
+        if(instr.op == Op::Phi){
+            stream << " [bb" << instr.block->predecessors[i]->id << ']';
+        }
+    }
+
+    if(instr.op == Op::Jump){
+        stream << " bb" << instr.targets[0]->id;
+    } else if(instr.op == Op::Branch){
+        stream << ", bb" << instr.targets[0]->id << ", bb" << instr.targets[1]->id;
+    }
+
+    if(instr.hasResult()){
+        stream << "\t; uses: " << instr.users.size();
+    }
+
+    stream << '\n';
+}
+
+auto print(std::ostream& stream, const Function& function) -> void {
+
+    for(const auto& child : function.functions){
+        print(stream, *child);
+    }
+
+    const char* name = !function.name.empty()
+        ? function.name.c_str()
+        : "<script>";
+
+    stream << "======= IR " << name << " =======\n";
+
+    for(const auto& block : function.blocks){
+        stream << "bb" << block->id << ':';
+
+        if(!block->predecessors.empty()){
+            stream << "\t; preds:";
+            for(const BasicBlock* pred : block->predecessors){
+                stream << " bb" << pred->id;
+            }
+        }
+
+        stream << '\n';
+
+        for(const auto& phi : block->phis){
+            printInstruction(stream, *phi);
+        }
+
+        for(const auto& instr : block->instructions){
+            printInstruction(stream, *instr);
+        }
+    }
+
+    stream << "======= end IR " << name << " =======\n";
+}
+
+}
@@ -0,0 +1,777 @@
+#include "../include/ir_builder.h"
+#include "../include/utils.h"
+
+#include <algorithm>
+
+namespace scriptlang::ir {
+
+using scriptlang::utils::instanceof;
+
+auto Builder::build(const StatementList& program) -> std::unique_ptr<Function> {
+
+    analysis::ProgramAnalysis analysis(program);
+    analysis_ = &analysis;
+
+    auto function = std::make_unique<Function>();
+    function_ = function.get();
+
+    current_ = newBlock();
+    sealBlock(current_);
+
+    buildStatements(program);
+
+    if(!isTerminated()){
+        append(Op::Return, { constant(Value()) });
+    }
+
+    removeUnreachableBlocks();
+    removeReplacedPhis();
+    renumber();
+
+    analysis_ = nullptr;
+
+    return function;
+}
+
+auto Builder::buildFunction(const FunctionDeclaration& decl) -> std::unique_ptr<Function> {
+
+    auto function = std::make_unique<Function>();
+    function->name = decl.name().lexeme;
+    function->arity = decl.params().size();
+
+    Builder builder;
+    builder.analysis_ = analysis_;
+    builder.function_ = function.get();
+    builder.location_ = location_;
+
+    builder.current_ = builder.newBlock();
+    builder.sealBlock(builder.current_);
+
+    builder.beginScope();
+
+    for(std::size_t i = 0; i < decl.params().size(); i++){
+        const TypeAnnotation type = decl.annotations()[i];
+        const int variable = builder.declareVariable(decl.params()[i].lexeme, type);
+
+        Instruction* param = builder.append(Op::Parameter);
+        param->index = static_cast<int>(i);
+
+        builder.writeVariable(variable, builder.current_, builder.check(param, type));
+    }
+
+    const auto& body = static_cast<Block*>(decl.body().get())->statements();
+    builder.buildStatements(body);
+
+    if(!builder.isTerminated()){
+        builder.append(Op::Return, { builder.constant(Value()) });
+    }
+
+    builder.removeUnreachableBlocks();
+    builder.removeReplacedPhis();
+    builder.renumber();
+
+    return function;
+}
+
+auto Builder::buildStatements(const StatementList& statements) -> void {
+
+    for(const auto& stmt : statements){
+        // Anything after a return, break or continue is unreachable.
+        if(isTerminated()) return;
+
+        location_ = stmt->location().start.offset;
+        stmt->accept(*this);
+    }
+}
+
+auto Builder::buildExpression(const ExpressionPtr& expr) -> Instruction* {
+    location_ = expr->location().start.offset;
+    expr->accept(*this);
+
+    return value_;
+}
+
+auto Builder::newBlock() -> BasicBlock* {
+    function_->blocks.push_back(std::make_unique<BasicBlock>(function_->blocks.size()));
+    return function_->blocks.back().get();
+}
+
+auto Builder::newInstruction(Op op, BasicBlock* block) -> std::unique_ptr<Instruction> {
+    return std::make_unique<Instruction>(op, nextId_++, location_, block);
+}
+
+auto Builder::append(Op op, std::initializer_list<Instruction*> operands) -> Instruction* {
+
+    current_->instructions.push_back(newInstruction(op, current_));
+    Instruction* instr = current_->instructions.back().get();
+
+    for(Instruction* operand : operands){
+        instr->addOperand(operand);
+    }
+
+    return instr;
+}
+
+auto Builder::constant(Value value) -> Instruction* {
+    Instruction* instr = append(Op::Constant);
+    instr->constant = std::move(value);
+
+    return instr;
+}
+
+auto Builder::check(Instruction* value, TypeAnnotation type) -> Instruction* {
+
+    // Literals were checked by the Compiler already.
+    if(type == TypeAnnotation::None || value->op == Op::Constant) return value;
+    if(value->op == Op::Check && value->index == static_cast<int>(type)) return value;
+
+    Instruction* instr = append(Op::Check, { value });
+    instr->index = static_cast<int>(type);
+
+    return instr;
+}
+
+auto Builder::jump(BasicBlock* target) -> void {
+    Instruction* instr = append(Op::Jump);
+    instr->targets[0] = target;
+
+    addEdge(current_, target);
+}
+
+auto Builder::branch(Instruction* condition, BasicBlock* then, BasicBlock* otherwise) -> void {
+    Instruction* instr = append(Op::Branch, { condition });
+    instr->targets[0] = then;
+    instr->targets[1] = otherwise;
+
+    addEdge(current_, then);
+    addEdge(current_, otherwise);
+}
+
+auto Builder::addEdge(BasicBlock* from, BasicBlock* to) -> void {
+    from->successors.push_back(to);
+    to->predecessors.push_back(from);
+}
+
+auto Builder::isTerminated() const -> bool {
+    return current_->terminator() != nullptr;
+}
+
+auto Builder::beginScope() -> void {
+    scopes_.emplace_back();
+}
+
+auto Builder::endScope() -> void {
+    scopes_.pop_back();
+}
+
+auto Builder::declareVariable(std::string_view name, TypeAnnotation type) -> int {
+    scopes_.back().push_back({ name, variablesCount_, type });
+    return variablesCount_++;
+}
+
+auto Builder::resolveVariable(std::string_view name) const -> int {
+
+    for(auto scope = scopes_.rbegin(); scope != scopes_.rend(); scope++){
+        for(auto variable = scope->rbegin(); variable != scope->rend(); variable++){
+            if(variable->name == name) return variable->id;
+        }
+    }
+
+    for(const Variable& variable : promoted_){
+        if(variable.name == name) return variable.id;
+    }
+
+    return -1;
+}
+
+auto Builder::annotationOf(std::string_view name) const -> TypeAnnotation {
+
+    for(auto scope = scopes_.rbegin(); scope != scopes_.rend(); scope++){
+        for(auto variable = scope->rbegin(); variable != scope->rend(); variable++){
+            if(variable->name == name) return variable->type;
+        }
+    }
+
+    const analysis::GlobalInfo* info = analysis_->global(name);
+    return info != nullptr ? info->annotation : TypeAnnotation::None;
+}
+
+auto Builder::writeVariable(int variable, BasicBlock* block, Instruction* value) -> void {
+    currentDef_[block][variable] = value;
+}
+
+auto Builder::readVariable(int variable, BasicBlock* block) -> Instruction* {
+
+    auto& definitions = currentDef_[block];
+    const auto it = definitions.find(variable);
+
+    if(it == definitions.end()){
+        return readVariableRecursive(variable, block);
+    }
+
+    Instruction* value = it->second;
+    while(value->replacement != nullptr) value = value->replacement;
+
+    return value;
+}
+
+auto Builder::readVariableRecursive(int variable, BasicBlock* block) -> Instruction* {
+
+    Instruction* value;
+
+    if(sealed_.count(block) == 0){
+        block->phis.push_back(newInstruction(Op::Phi, block));
+        value = block->phis.back().get();
+
+        incompletePhis_[block][variable] = value;
+    } else if(block->predecessors.size() == 1){
+        value = readVariable(variable, block->predecessors[0]);
+    } else if(block->predecessors.empty()){
+        // Only reachable from dead code, the value is never observed.
+        block->instructions.insert(block->instructions.begin(), newInstruction(Op::Constant, block));
+        value = block->instructions.front().get();
+    } else {
+        block->phis.push_back(newInstruction(Op::Phi, block));
+        value = block->phis.back().get();
+
+        writeVariable(variable, block, value);
+        value = addPhiOperands(variable, value);
+    }
+
+    writeVariable(variable, block, value);
+    return value;
+}
+
+auto Builder::addPhiOperands(int variable, Instruction* phi) -> Instruction* {
+
+    for(BasicBlock* pred : phi->block->predecessors){
+        phi->addOperand(readVariable(variable, pred));
+    }
+
+    return tryRemoveTrivialPhi(phi);
+}
+
+auto Builder::tryRemoveTrivialPhi(Instruction* phi) -> Instruction* {
+
+    Instruction* same = nullptr;
+
+    for(Instruction* operand : phi->operands){
+        if(operand == same || operand == phi) continue;
+        if(same != nullptr) return phi;
+
+        same = operand;
+    }
+
+    if(same == nullptr){
+        BasicBlock* block = phi->block;
+
+        block->instructions.insert(block->instructions.begin(), newInstruction(Op::Constant, block));
+        same = block->instructions.front().get();
+    }
+
+    std::vector<Instruction*> users;
+    for(Instruction* user : phi->users){
+        if(user != phi) users.push_back(user);
+    }
+
+    for(Instruction* operand : phi->operands){
+        operand->removeUser(phi);
+    }
+
+    phi->operands.clear();
+    phi->replaceAllUsesWith(same);
+    phi->replacement = same;
+
+    for(Instruction* user : users){
+        if(user->op == Op::Phi && user->replacement == nullptr){
+            tryRemoveTrivialPhi(user);
+        }
+    }
+
+    return same;
+}
+
+auto Builder::sealBlock(BasicBlock* block) -> void {
+
+    const auto incomplete = incompletePhis_.find(block);
+
+    if(incomplete != incompletePhis_.end()){
+        for(const auto& [variable, phi] : incomplete->second){
+            addPhiOperands(variable, phi);
+        }
+
+        incompletePhis_.erase(incomplete);
+    }
+
+    sealed_.insert(block);
+}
+
+auto Builder::removeUnreachableBlocks() -> void {
+
+    std::unordered_set<BasicBlock*> reachable;
+    std::vector<BasicBlock*> worklist { function_->blocks.front().get() };
+
+    while(!worklist.empty()){
+        BasicBlock* block = worklist.back();
+        worklist.pop_back();
+
+        if(!reachable.insert(block).second) continue;
+
+        for(BasicBlock* succ : block->successors){
+            worklist.push_back(succ);
+        }
+    }
+
+    std::vector<Instruction*> phis;
+
+    for(const auto& block : function_->blocks){
+        if(reachable.count(block.get()) != 0) continue;
+
+        for(BasicBlock* succ : block->successors){
+            auto& preds = succ->predecessors;
+            const auto index = std::find(preds.begin(), preds.end(), block.get()) - preds.begin();
+
+            preds.erase(preds.begin() + index);
+
+            for(const auto& phi : succ->phis){
+                if(phi->replacement != nullptr) continue;
+
+                phi->operands[index]->removeUser(phi.get());
+                phi->operands.erase(phi->operands.begin() + index);
+                phis.push_back(phi.get());
+            }
+        }
+
+        for(const auto& instr : block->instructions){
+            for(Instruction* operand : instr->operands){
+                operand->removeUser(instr.get());
+            }
+        }
+    }
+
+    auto& blocks = function_->blocks;
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](const auto& block) {
+        return reachable.count(block.get()) == 0;
+    }), blocks.end());
+
+    for(Instruction* phi : phis){
+        if(phi->replacement == nullptr) tryRemoveTrivialPhi(phi);
+    }
+}
+
+auto Builder::removeReplacedPhis() -> void {
+
+    for(const auto& block : function_->blocks){
+        auto& phis = block->phis;
+
+        phis.erase(std::remove_if(phis.begin(), phis.end(), [](const auto& phi) {
+            return phi->replacement != nullptr;
+        }), phis.end());
+    }
+}
+
+auto Builder::renumber() -> void {
+
+    std::uint32_t id = 0;
+    std::uint32_t blockId = 0;
+
+    for(const auto& block : function_->blocks){
+        block->id = blockId++;
+
+        for(const auto& phi : block->phis){
+            phi->id = id++;
+        }
+
+        for(const auto& instr : block->instructions){
+            instr->id = id++;
+        }
+    }
+}
+
+auto Builder::visitVariableDeclaration(const VariableDeclaration& decl) -> void {
+
+    Instruction* value = check(buildExpression(decl.initializer()), decl.annotation());
+
+    // Globals no function refers to are variables of the script like locals.
+    if(scopes_.empty() && analysis_->global(decl.name().lexeme)->promotable){
+        promoted_.push_back({ decl.name().lexeme, variablesCount_++, decl.annotation() });
+        writeVariable(promoted_.back().id, current_, value);
+        return;
+    }
+
+    if(scopes_.empty()){
+        Instruction* define = append(Op::DefineGlobal, { value });
+        define->name = decl.name().lexeme;
+        return;
+    }
+
+    writeVariable(declareVariable(decl.name().lexeme, decl.annotation()), current_, value);
+}
+
+auto Builder::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
+
+    function_->functions.push_back(buildFunction(decl));
+
+    Instruction* value = append(Op::Function);
+    value->index = function_->functions.size() - 1;
+
+    if(scopes_.empty()){
+        Instruction* define = append(Op::DefineGlobal, { value });
+        define->name = decl.name().lexeme;
+        return;
+    }
+
+    writeVariable(declareVariable(decl.name().lexeme), current_, value);
+}
+
+auto Builder::visitBlock(const Block& block) -> void {
+    beginScope();
+    buildStatements(block.statements());
+    endScope();
+}
+
+auto Builder::visitWhileStatement(const WhileStatement& stmt) -> void {
+
+    BasicBlock* header = newBlock();
+    jump(header);
+
+    current_ = header;
+    Instruction* condition = buildExpression(stmt.condition());
+
+    BasicBlock* body = newBlock();
+    BasicBlock* exit = newBlock();
+
+    branch(condition, body, exit);
+    sealBlock(body);
+
+    LoopContext loop { loop_, header, exit };
+    loop_ = &loop;
+
+    current_ = body;
+    stmt.body()->accept(*this);
+
+    if(!isTerminated()) jump(header);
+
+    loop_ = loop.enclosing;
+
+    sealBlock(header);
+    sealBlock(exit);
+
+    current_ = exit;
+}
+
+auto Builder::visitForStatement(const ForStatement& stmt) -> void {
+
+    // The runtime checks of a numeric `for` have no IR counterpart, the
+    // CFG only approximates the loop.
+    beginScope();
+
+    const int counter = declareVariable("$for");
+    writeVariable(counter, current_, buildExpression(stmt.start()));
+
+    Instruction* limit = buildExpression(stmt.limit());
+    Instruction* step = stmt.haveStep()
+        ? buildExpression(stmt.step())
+        : constant(Value(std::int64_t(1)));
+
+    BasicBlock* header = newBlock();
+    jump(header);
+
+    // The counter has passed the limit when (counter - limit) * step > 0,
+    // whichever the direction of the step.
+    current_ = header;
+    Instruction* value = readVariable(counter, current_);
+    Instruction* distance = append(Op::Mult, { append(Op::Sub, { value, limit }), step });
+    Instruction* passed = append(Op::Greater, { distance, constant(Value(std::int64_t(0))) });
+
+    BasicBlock* body = newBlock();
+    BasicBlock* latch = newBlock();
+    BasicBlock* exit = newBlock();
+
+    branch(passed, exit, body);
+    sealBlock(body);
+
+    LoopContext loop { loop_, latch, exit };
+    loop_ = &loop;
+
+    current_ = body;
+    beginScope();
+    writeVariable(declareVariable(stmt.variable().lexeme), current_, value);
+    stmt.body()->accept(*this);
+    endScope();
+
+    if(!isTerminated()) jump(latch);
+
+    loop_ = loop.enclosing;
+
+    sealBlock(latch);
+    current_ = latch;
+    writeVariable(counter, current_, append(Op::Add, { readVariable(counter, current_), step }));
+    jump(header);
+
+    sealBlock(header);
+    sealBlock(exit);
+
+    current_ = exit;
+    endScope();
+}
+
+auto Builder::visitIfStatement(const IfStatement& stmt) -> void {
+
+    Instruction* condition = buildExpression(stmt.condition());
+
+    BasicBlock* then = newBlock();
+    BasicBlock* otherwise = stmt.haveElseBranch() ? newBlock() : nullptr;
+    BasicBlock* join = newBlock();
+
+    branch(condition, then, otherwise != nullptr ? otherwise : join);
+    sealBlock(then);
+
+    current_ = then;
+    stmt.thenBranch()->accept(*this);
+    if(!isTerminated()) jump(join);
+
+    if(otherwise != nullptr){
+        sealBlock(otherwise);
+
+        current_ = otherwise;
+        stmt.elseBranch()->accept(*this);
+        if(!isTerminated()) jump(join);
+    }
+
+    sealBlock(join);
+    current_ = join;
+}
+
+auto Builder::visitMatchStatement(const MatchStatement& stmt) -> void {
+
+    // A chain of equality tests, the IR has no jump tables.
+    Instruction* subject = buildExpression(stmt.subject());
+
+    std::vector<BasicBlock*> arms;
+    BasicBlock* join = newBlock();
+
+    for(const auto& arm : stmt.arms()){
+        BasicBlock* body = newBlock();
+        arms.push_back(body);
+
+        for(const auto& label : arm.labels){
+            Instruction* equal = append(Op::Equal, { subject, buildExpression(label) });
+            BasicBlock* next = newBlock();
+
+            branch(equal, body, next);
+            sealBlock(next);
+
+            current_ = next;
+        }
+    }
+
+    if(stmt.haveElseBranch()){
+        stmt.elseBranch()->accept(*this);
+    }
+
+    if(!isTerminated()) jump(join);
+
+    for(std::size_t i = 0; i < arms.size(); i++){
+        sealBlock(arms[i]);
+
+        current_ = arms[i];
+        stmt.arms()[i].body->accept(*this);
+        if(!isTerminated()) jump(join);
+    }
+
+    sealBlock(join);
+    current_ = join;
+}
+
+auto Builder::visitExpressionStatement(const ExpressionStatement& stmt) -> void {
+    buildExpression(stmt.expression());
+}
+
+auto Builder::visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {
+    jump(loop_->header);
+}
+
+auto Builder::visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {
+    jump(loop_->exit);
+}
+
+auto Builder::visitReturnStatement(const ReturnStatement& stmt) -> void {
+
+    Instruction* value = stmt.haveExpression()
+        ? buildExpression(stmt.expression())
+        : constant(Value());
+
+    append(Op::Return, { value });
+}
+
+auto Builder::visitPrintStatement(const PrintStatement& stmt) -> void {
+    append(Op::Print, { buildExpression(stmt.expression()) });
+}
+
+auto Builder::visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+
+    Instruction* value = check(buildExpression(expr.value()), annotationOf(expr.name().lexeme));
+    const int variable = resolveVariable(expr.name().lexeme);
+
+    if(variable != -1){
+        writeVariable(variable, current_, value);
+    } else {
+        Instruction* set = append(Op::SetGlobal, { value });
+        set->name = expr.name().lexeme;
+    }
+
+    value_ = value;
+}
+
+auto Builder::visitBinaryExpression(const BinaryExpression& expr) -> void {
+
+    const TokenType operatorType = expr.op().type;
+
+    if(operatorType == TokenType::AndKeyword || operatorType == TokenType::OrKeyword){
+
+        Instruction* left = buildExpression(expr.left());
+
+        BasicBlock* rhs = newBlock();
+        BasicBlock* join = newBlock();
+
+        // Short-circuit keeps the left operand as the result.
+        if(operatorType == TokenType::AndKeyword){
+            branch(left, rhs, join);
+        } else {
+            branch(left, join, rhs);
+        }
+
+        sealBlock(rhs);
+
+        BasicBlock* leftBlock = current_;
+
+        current_ = rhs;
+        Instruction* right = buildExpression(expr.right());
+        jump(join);
+
+        sealBlock(join);
+        current_ = join;
+
+        join->phis.push_back(newInstruction(Op::Phi, join));
+        Instruction* phi = join->phis.back().get();
+
+        for(BasicBlock* pred : join->predecessors){
+            phi->addOperand(pred == leftBlock ? left : right);
+        }
+
+        value_ = tryRemoveTrivialPhi(phi);
+        return;
+    }
+
+    Instruction* left = buildExpression(expr.left());
+    Instruction* right = buildExpression(expr.right());
+
+    switch(operatorType){
+        case TokenType::Minus:
+            value_ = append(Op::Sub, { left, right });
+            break;
+        case TokenType::Plus:
+            value_ = append(Op::Add, { left, right });
+            break;
+        case TokenType::Star:
+            value_ = append(Op::Mult, { left, right });
+            break;
+        case TokenType::Slash:
+            value_ = append(Op::Div, { left, right });
+            break;
+        case TokenType::Exponent:
+            value_ = append(Op::Pow, { left, right });
+            break;
+        case TokenType::Less:
+            value_ = append(Op::Less, { left, right });
+            break;
+        case TokenType::Greater:
+            value_ = append(Op::Greater, { left, right });
+            break;
+        case TokenType::LessEqual:
+            value_ = append(Op::Not, { append(Op::Greater, { left, right }) });
+            break;
+        case TokenType::GreaterEqual:
+            value_ = append(Op::Not, { append(Op::Less, { left, right }) });
+            break;
+        case TokenType::Equal:
+            value_ = append(Op::Equal, { left, right });
+            break;
+        case TokenType::NotEqual:
+            value_ = append(Op::Not, { append(Op::Equal, { left, right }) });
+            break;
+        default:
+            value_ = constant(Value());
+            break;
+    }
+}
+
+auto Builder::visitUnaryExpression(const UnaryExpression& expr) -> void {
+
+    Instruction* right = buildExpression(expr.right());
+
+    switch(expr.op().type){
+        case TokenType::Minus:
+            value_ = append(Op::Negate, { right });
+            break;
+        case TokenType::NotKeyword:
+            value_ = append(Op::Not, { right });
+            break;
+        default:
+            value_ = right;
+            break;
+    }
+}
+
+auto Builder::visitCallExpression(const CallExpression& expr) -> void {
+
+    std::vector<Instruction*> operands { buildExpression(expr.callee()) };
+
+    for(const auto& arg : expr.arguments()){
+        operands.push_back(buildExpression(arg));
+    }
+
+    Instruction* call = append(Op::Call);
+    call->index = expr.arguments().size();
+
+    for(Instruction* operand : operands){
+        call->addOperand(operand);
+    }
+
+    value_ = call;
+}
+
+auto Builder::visitGroupingExpression(const GroupingExpression& expr) -> void {
+    value_ = buildExpression(expr.expression());
+}
+
+auto Builder::visitVariableExpression(const VariableExpression& expr) -> void {
+
+    const int variable = resolveVariable(expr.name().lexeme);
+
+    if(variable != -1){
+        value_ = readVariable(variable, current_);
+        return;
+    }
+
+    value_ = append(Op::GetGlobal);
+    value_->name = expr.name().lexeme;
+}
+
+auto Builder::visitLiteralExpression(const LiteralExpression& expr) -> void {
+
+    if(expr.isBoolean()){
+        value_ = constant(expr.asBoolean());
+    } else if(expr.isInteger()){
+        value_ = constant(expr.asInteger());
+    } else if(expr.isNumber()){
+        value_ = constant(expr.asNumber());
+    } else if(expr.isString()){
+        value_ = constant(std::string(expr.asString()));
+    } else {
+        value_ = constant(Value());
+    }
+}
+
+}
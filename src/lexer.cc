@@ -1,36 +1,179 @@
 #include "../include/lexer.h"
 
 #include <cctype>
+#include <cstring>
 #include <iterator>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace scriptlang::lexer {
 
-Lexer::Lexer(std::string_view source) 
-    : source_(source), 
-      curr_(source_.begin()),
-      start_(source_.begin()) {
+// Scanning helpers. With SSE2 they classify 16 bytes at a time and finish
+// the last partial block with the scalar loop, which is also the whole
+// implementation on other targets. Single characters are searched with
+// memchr, already vectorized by the C library.
+
+static constexpr auto isBlank(char c) -> bool {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static constexpr auto isIdentifierCharacter(char c) -> bool {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '-' || c == '_';
+}
+
+#if defined(__SSE2__)
+
+static inline auto load(const char* it) -> __m128i {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+}
+
+static inline auto equal(__m128i block, char c) -> __m128i {
+    return _mm_cmpeq_epi8(block, _mm_set1_epi8(c));
+}
+
+// Bytes in [low, high], bytes above 0x7f are negative and never match.
+static inline auto inRange(__m128i block, char low, char high) -> __m128i {
+    return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(low - 1)),
+                         _mm_cmplt_epi8(block, _mm_set1_epi8(high + 1)));
+}
+
+#endif
+
+// First byte of [it, end) that is not a space, tab, carriage return or newline.
+static auto skipBlanks(const char* it, const char* end) -> const char* {
+
+#if defined(__SSE2__)
+    for(; end - it >= 16; it += 16){
+        const __m128i block = load(it);
+        const __m128i blank = _mm_or_si128(_mm_or_si128(equal(block, ' '), equal(block, '\t')),
+                                           _mm_or_si128(equal(block, '\r'), equal(block, '\n')));
+
+        const unsigned others = ~static_cast<unsigned>(_mm_movemask_epi8(blank)) & 0xffff;
+        if(others != 0) return it + __builtin_ctz(others);
+    }
+#endif
+
+    while(it < end && isBlank(*it)) it++;
+    return it;
+}
+
+// First byte of [it, end) that cannot continue an identifier.
+static auto skipIdentifier(const char* it, const char* end) -> const char* {
+
+#if defined(__SSE2__)
+    for(; end - it >= 16; it += 16){
+        const __m128i block = load(it);
+        const __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+
+        const __m128i valid = _mm_or_si128(_mm_or_si128(inRange(lower, 'a', 'z'), inRange(block, '0', '9')),
+                                           _mm_or_si128(equal(block, '-'), equal(block, '_')));
+
+        const unsigned others = ~static_cast<unsigned>(_mm_movemask_epi8(valid)) & 0xffff;
+        if(others != 0) return it + __builtin_ctz(others);
+    }
+#endif
 
-    keywords_ = {
-        {"let", TokenType::LetKeyword},
-        {"defun", TokenType::DefunKeyword},
-        {"if", TokenType::IfKeyword},
-        {"else", TokenType::ElseKeyword},
-        {"while", TokenType::WhileKeyword},
-        {"continue", TokenType::ContinueKeyword},
-        {"break", TokenType::BreakKeyword},
-        {"return", TokenType::ReturnKeyword},
-        {"print", TokenType::PrintKeyword},
-        {"or", TokenType::OrKeyword},
-        {"and", TokenType::AndKeyword},
-        {"not", TokenType::NotKeyword},
-        {"true", TokenType::TrueKeyword},
-        {"false", TokenType::FalseKeyword},
-        {"nil", TokenType::NilKeyword},
+    while(it < end && isIdentifierCharacter(*it)) it++;
+    return it;
+}
+
+// First quote, comment, NUL or, with `newlines`, newline in [it, end).
+static auto findSplitCharacter(const char* it, const char* end, bool newlines) -> const char* {
+
+    const auto isSplitCharacter = [newlines](char c){
+        return c == '"' || c == '#' || c == '\0' || (newlines && c == '\n');
     };
 
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8(newlines ? '\n' : '"');
+
+    for(; end - it >= 16; it += 16){
+        const __m128i block = load(it);
+        const __m128i found = _mm_or_si128(_mm_or_si128(equal(block, '"'), equal(block, '#')),
+                                           _mm_or_si128(equal(block, '\0'), _mm_cmpeq_epi8(block, newline)));
+
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+        if(mask != 0) return it + __builtin_ctz(mask);
+    }
+#endif
+
+    while(it < end && !isSplitCharacter(*it)) it++;
+    return it;
+}
+
+// Keywords are told apart by their first character, and their length
+// where that is shared, so at most one comparison is made per identifier.
+static constexpr auto keywordType(std::string_view lexeme) -> TokenType {
+
+    const auto keyword = [lexeme](std::string_view spelling, TokenType type) {
+        return lexeme == spelling ? type : TokenType::Identifier;
+    };
+
+    switch(lexeme[0]){
+        case 'a':
+            return keyword("and", TokenType::AndKeyword);
+        case 'b':
+            return keyword("break", TokenType::BreakKeyword);
+        case 'c':
+            return keyword("continue", TokenType::ContinueKeyword);
+        case 'd':
+            return keyword("defun", TokenType::DefunKeyword);
+        case 'e':
+            return keyword("else", TokenType::ElseKeyword);
+        case 'f':
+            return lexeme.size() == 3
+                ? keyword("for", TokenType::ForKeyword)
+                : keyword("false", TokenType::FalseKeyword);
+        case 'i':
+            return keyword("if", TokenType::IfKeyword);
+        case 'l':
+            return keyword("let", TokenType::LetKeyword);
+        case 'm':
+            return keyword("match", TokenType::MatchKeyword);
+        case 'n':
+            return lexeme.size() == 3 && lexeme[1] == 'i'
+                ? keyword("nil", TokenType::NilKeyword)
+                : keyword("not", TokenType::NotKeyword);
+        case 'o':
+            return keyword("or", TokenType::OrKeyword);
+        case 'p':
+            return keyword("print", TokenType::PrintKeyword);
+        case 'r':
+            return keyword("return", TokenType::ReturnKeyword);
+        case 't':
+            return keyword("true", TokenType::TrueKeyword);
+        case 'w':
+            return keyword("while", TokenType::WhileKeyword);
+        default:
+            return TokenType::Identifier;
+    }
+}
+
+Lexer::Lexer(SourceBuffer source)
+    : Lexer(source, source.text.size() >= PARALLEL_THRESHOLD
+                  ? std::thread::hardware_concurrency()
+                  : 1) {}
+
+Lexer::Lexer(SourceBuffer source, std::size_t threads)
+    : source_(source.text),
+      base_(source.start),
+      curr_(source_.begin()),
+      start_(source_.begin()) {
+
+    if(threads > 1) lexChunks(threads);
 }
 
 auto Lexer::next() -> Token {
+    return chunks_.empty()
+        ? scan()
+        : nextFromChunks();
+}
+
+auto Lexer::scan() -> Token {
 
     skipWhiteSpaces();
 
@@ -75,6 +218,8 @@ auto Lexer::next() -> Token {
             return makeToken(TokenType::Comma);
         case ';':
             return makeToken(TokenType::Semicolon);
+        case ':':
+            return makeToken(TokenType::Colon);
         case '(':
             return makeToken(TokenType::LeftParen);
         case ')':
@@ -83,6 +228,8 @@ auto Lexer::next() -> Token {
             return makeToken(TokenType::LeftBrace);
         case '}':
             return makeToken(TokenType::RightBrace);
+        case '@':
+            return makeToken(TokenType::At);
         case '"':
             return stringLiteral();
         default:
@@ -103,9 +250,99 @@ auto Lexer::hasNext() const -> bool {
     return hasNext_;
 }
 
+auto Lexer::findSplits(std::size_t count) const -> std::vector<std::uint32_t> {
+
+    std::vector<std::uint32_t> splits { 0 };
+
+    const char* it = source_.data();
+    const char* end = this->end();
+
+    // Strings and comments are jumped over, no split happens past a NUL
+    // outside of them since the serial lexer ends there.
+    for(std::size_t i = 1; i < count; i++){
+        const char* target = source_.data() + source_.size() * i / count;
+
+        while(true){
+            // Newlines only matter from the target on.
+            const char* limit = it < target ? target : end;
+
+            it = findSplitCharacter(it, limit, limit == end);
+            if(it == target && limit == target) continue;
+            if(it == end || *it == '\0') return splits;
+
+            if(*it == '\n'){
+                splits.push_back(it - source_.data());
+                it++;
+                break;
+            }
+
+            if(*it == '"'){
+                it = static_cast<const char*>(std::memchr(it + 1, '"', end - it - 1));
+                if(it == nullptr) return splits;
+                it++;
+            } else {
+                it = static_cast<const char*>(std::memchr(it, '\n', end - it));
+                if(it == nullptr) return splits;
+            }
+        }
+    }
+
+    return splits;
+}
+
+auto Lexer::lexChunks(std::size_t count) -> void {
+
+    const std::vector<std::uint32_t> splits = findSplits(count);
+    if(splits.size() < 2) return;
+
+    for(std::size_t i = 0; i < splits.size(); i++){
+        const std::uint32_t start = splits[i];
+        const std::uint32_t end = i + 1 < splits.size()
+            ? splits[i + 1]
+            : source_.size();
+
+        chunks_.push_back(std::async(std::launch::async, [this, start, end]{
+            Lexer lexer(SourceBuffer { source_.substr(start, end - start), base_ + start }, 1);
+
+            std::vector<Token> tokens;
+            tokens.reserve((end - start) / 8);
+
+            do {
+                tokens.push_back(lexer.scan());
+            } while(tokens.back().type != TokenType::Eof);
+
+            return tokens;
+        }));
+    }
+}
+
+auto Lexer::nextFromChunks() -> Token {
+
+    if(index_ == tokens_.size()){
+        tokens_ = chunks_[chunk_].get();
+        index_ = 0;
+    }
+
+    const Token& token = tokens_[index_];
+
+    if(token.type == TokenType::Eof){
+        if(chunk_ + 1 < chunks_.size()){
+            chunk_++;
+            index_ = tokens_.size();
+            return nextFromChunks();
+        }
+
+        hasNext_ = false;
+        return token;
+    }
+
+    return tokens_[index_++];
+}
+
 auto Lexer::stringLiteral() -> Token {
 
-    while(!isAtEnd() && peek(0) != '"') advance();
+    const char* quote = static_cast<const char*>(std::memchr(position(), '"', end() - position()));
+    advanceTo(quote != nullptr ? quote : end());
     
     if(isAtEnd()) {
         // TODO: write error message for unterminated string literal.
@@ -119,52 +356,48 @@ auto Lexer::stringLiteral() -> Token {
 auto Lexer::numberLiteral() -> Token {
     while(std::isdigit(peek(0)) && !isAtEnd()) advance();
 
+    // Digits alone are an integer, a fraction or an exponent make a double.
+    TokenType type = TokenType::IntegerLiteral;
+
     if(peek(0) == '.' && std::isdigit(peek(1))){
         advance();
         while(std::isdigit(peek(0)) && !isAtEnd()) advance();        
+        type = TokenType::NumberLiteral;
     }
 
     if(match('e') || match('E')){
         if(peek(0) == '-' || peek(0) == '+') advance();
         while(std::isdigit(peek(0)) && !isAtEnd()) advance();
+        type = TokenType::NumberLiteral;
     }
 
-    return makeToken(TokenType::NumberLiteral);
+    return makeToken(type);
 }
 
-auto Lexer::getIdentiferType() -> TokenType {
+auto Lexer::getIdentiferType() const -> TokenType {
 
     std::string_view lexeme = 
         source_.substr(std::distance(source_.begin(), start_),
                        std::distance(start_, curr_));
 
-    try {
-        return keywords_.at(lexeme);
-    }catch(...){
-    }
-
-    return TokenType::Identifier;
-}
-
-auto Lexer::isValidIdentiferCharacter(char c) const -> bool {
-    return std::isalnum(c) || c == '-' || c == '_';
+    return keywordType(lexeme);
 }
 
 auto Lexer::identifier() -> Token {
-
-    while(isValidIdentiferCharacter(peek(0)) && !isAtEnd()){
-        advance();
-    }
-
+    advanceTo(skipIdentifier(position(), end()));
     return makeToken(getIdentiferType());
 }
 
 auto Lexer::advance() -> char {
     return !isAtEnd()
-        ? (column_++, *curr_++)
+        ? *curr_++
         : '\0';
 }
 
+auto Lexer::advanceTo(const char* stop) -> void {
+    curr_ += stop - position();
+}
+
 auto Lexer::peek(std::uint32_t pos) const -> char {
     return (curr_ + pos < source_.end())
         ? *(curr_ + pos)
@@ -177,38 +410,33 @@ auto Lexer::match(char c) -> bool {
         : false;
 }
 
+auto Lexer::position() const -> const char* {
+    return source_.data() + std::distance(source_.begin(), curr_);
+}
+
+auto Lexer::end() const -> const char* {
+    return source_.data() + source_.size();
+}
+
 auto Lexer::isAtEnd() const -> bool {
     return curr_ >= source_.end();
 }
 
 auto Lexer::getCurrentPosition() const -> SourcePosition {
     const std::uint32_t offset = std::distance(source_.begin(), curr_);
-    return SourcePosition { source_, offset, line_, column_ };
+    return SourcePosition { base_ + offset };
 }
 
 auto Lexer::skipWhiteSpaces() -> void {
 
     while(!isAtEnd()){
-        switch(peek(0)){
-            case '#':
-                while(!isAtEnd() && peek(0) != '\n') advance();
-                if(isAtEnd()) break;
-                [[fallthrough]];
-            case '\n':
-                line_++;
-                column_ = 1;
-                [[fallthrough]];
-            case '\t':
-                [[fallthrough]];
-            case ' ':
-                [[fallthrough]];
-            case '\r':
-                break;
-            default:
-                return;
-        }
+        advanceTo(skipBlanks(position(), end()));
 
-        advance();
+        if(peek(0) != '#') return;
+
+        // The comment ends before its newline, skipped as a blank next.
+        const char* eol = static_cast<const char*>(std::memchr(position(), '\n', end() - position()));
+        advanceTo(eol != nullptr ? eol : end());
     }
 }
 
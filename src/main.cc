@@ -1,27 +1,87 @@
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
+#include "../include/bounded_queue.h"
 #include "../include/parser.h"
 #include "../include/compiler.h"
+#include "../include/document.h"
+#include "../include/ir_builder.h"
+#include "../include/lexer.h"
+#include "../include/memo.h"
+#include "../include/profile.h"
+#include "../include/single_pass.h"
+#include "../include/source_manager.h"
 #include "../include/vm.h"
 
 using scriptlang::compiler::Compiler;
+using scriptlang::compiler::CompilerOptions;
+using scriptlang::compiler::SinglePassCompiler;
+using scriptlang::parser::Diagnostic;
+using scriptlang::parser::Document;
 using scriptlang::parser::Parser;
+using scriptlang::ast::Program;
+using scriptlang::ast::StatementPtr;
+using scriptlang::ir::Builder;
 using scriptlang::error::BasicErrorReporter;
+using scriptlang::lexer::Lexer;
+using scriptlang::lexer::SourceBuffer;
+using scriptlang::lexer::SourceManager;
+using scriptlang::lexer::Token;
+using scriptlang::lexer::TokenType;
 using scriptlang::ast::printer::AstPrettyPrinter;
+using scriptlang::runtime::InterpreterResult;
+using scriptlang::runtime::MemoCache;
+using scriptlang::runtime::ObjectFunction;
+using scriptlang::runtime::Profile;
+using scriptlang::runtime::Value;
 using scriptlang::runtime::VM;
-using scriptlang::types::Byte;
-
-constexpr Byte EXECUTE = 0b0000'0000;
-constexpr Byte DUMP_AST = 0b0000'0001;
-constexpr Byte DUMP_BYTECODE = 0b0000'0010;
+using scriptlang::types::Short;
+using scriptlang::utils::BoundedQueue;
+
+constexpr Short EXECUTE = 0b0000'0000'0000;
+constexpr Short DUMP_AST = 0b0000'0000'0001;
+constexpr Short DUMP_BYTECODE = 0b0000'0000'0010;
+constexpr Short INLINE_REPORT = 0b0000'0000'0100;
+constexpr Short INTERACTIVE = 0b0000'0000'1000;
+constexpr Short NO_OPTIMIZE = 0b0000'0001'0000;
+constexpr Short DUMP_IR = 0b0000'0100'0000;
+constexpr Short MEMO_STATS = 0b0000'1000'0000;
+constexpr Short SINGLE_PASS = 0b0001'0000'0000;
+constexpr Short PIPELINE = 0b0010'0000'0000;
+constexpr Short SERVER = 0b0100'0000'0000;
+
+constexpr Short DUMP = DUMP_AST | DUMP_BYTECODE | DUMP_IR;
+
+// The pipelined parser hands over the top-level statements in batches, and
+// runs at most PIPELINE_DEPTH batches ahead of the VM.
+constexpr std::size_t PIPELINE_BATCH = 16;
+constexpr std::size_t PIPELINE_DEPTH = 8;
 
 static VM vm;
 
+// Every source run so far, the REPL keeps the earlier lines for the errors
+// of the functions they declared.
+static SourceManager sources;
+
+// --profile-in and --profile-out, the output file also holds the counts of
+// the earlier runs.
+static Profile inputProfile;
+static Profile outputProfile;
+static const char* profileIn = nullptr;
+static const char* profileOut = nullptr;
+
 static auto readSourceFromFile(const char* path) -> std::string {
 
     std::ifstream stream(path);
@@ -43,14 +103,191 @@ static auto readSourceFromFile(const char* path) -> std::string {
     return source;
 }
 
-static auto runCode(const std::string& source, std::uint8_t flags) -> void {
+// Prints the cache statistics of every `@memo` function declared by `function`.
+static auto printMemoStats(const ObjectFunction& function) -> void {
+
+    for(std::size_t i = 0; i < function.chunk.constantsCount(); i++){
+        const Value& constant = function.chunk.getConstant(i);
+        if(!constant.isFunction()) continue;
+
+        const ObjectFunction& declared = constant.asFunction();
+        printMemoStats(declared);
+
+        const MemoCache* memo = declared.memo.get();
+        if(memo == nullptr) continue;
+
+        const std::uint64_t calls = memo->hits() + memo->misses();
+        const double rate = calls != 0 ? 100.0 * memo->hits() / calls : 0.0;
+
+        std::cout << "[Memo] '" << declared.name << "': "
+                  << memo->hits() << " hits, " << memo->misses() << " misses ("
+                  << std::fixed << std::setprecision(1) << rate << std::defaultfloat
+                  << "% hit rate), " << memo->evictions() << " evictions, "
+                  << memo->size() << " entries.\n";
+    }
+}
+
+// The single pass emits neither the dumps nor the inline report and has
+// no branch positions for the profile.
+static inline auto compilesInOnePass(Short flags) -> bool {
+    return (flags & SINGLE_PASS) && !(flags & (DUMP | INLINE_REPORT)) && profileOut == nullptr;
+}
+
+// A batch of top-level statements. From the first type annotation or
+// `@memo` on, which need the whole program, the batch holds the rest of the
+// source and the statements before `start` have run.
+struct PipelineBatch {
+    Program program;
+    bool wholeProgram = false;
+    std::uint32_t start = 0;
+};
+
+// Every name in the source before `end`.
+static auto namesBefore(SourceBuffer source, std::uint32_t end) -> std::unordered_set<std::string_view> {
+
+    std::unordered_set<std::string_view> names;
+    Lexer lexer(SourceBuffer { source.text.substr(0, end - source.start), source.start });
+
+    while(lexer.hasNext()){
+        const Token token = lexer.next();
+        if(token.type == TokenType::Identifier) names.insert(token.lexeme);
+    }
+
+    return names;
+}
+
+// The statements of `rest` follow those of `program`, in its arena.
+static auto append(Program& program, Program rest) -> void {
+
+    std::vector<StatementPtr> statements(program.statements.begin(), program.statements.end());
+    statements.insert(statements.end(), rest.statements.begin(), rest.statements.end());
+
+    program.statements = program.arena->copy(statements);
+    program.arena->adopt(*rest.arena);
+}
+
+// Each batch of statements is compiled on its own, as a REPL line is, and
+// there is nothing to print for the dumps and the inline report.
+static inline auto runsPipelined(Short flags) -> bool {
+    return (flags & PIPELINE) && !(flags & (DUMP | INLINE_REPORT));
+}
+
+// The parser runs ahead on its own thread while the batches of top-level
+// statements it finished are compiled and executed. The batches before an
+// error have already run when it is reported.
+static auto runPipelined(SourceBuffer source, Short flags) -> void {
+
+    BoundedQueue<PipelineBatch> queue(PIPELINE_DEPTH);
+
+    // Only touched by the parser thread until it is joined.
+    auto parseErrors = std::make_unique<BasicErrorReporter>(sources);
+
+    std::thread parserThread([&queue, &parseErrors, source](){
+        Parser parser(source, parseErrors.get());
+        std::uint32_t start = source.start;
+
+        // After an error the rest of the source is still parsed for the
+        // other errors, but nothing more is run.
+        for(Program program = parser.parseDeclarations(PIPELINE_BATCH);
+            !program.statements.empty();
+            program = parser.parseDeclarations(PIPELINE_BATCH)){
+
+            const bool wholeProgram = parser.parsedAnnotations();
+
+            if(wholeProgram){
+                append(program, parser.parseDeclarations(std::numeric_limits<std::size_t>::max()));
+            }
+
+            if(!parseErrors->hadError() && !queue.push({ std::move(program), wholeProgram, start })) break;
+
+            start = parser.parsedEnd().offset;
+        }
+
+        queue.close();
+    });
+
+    auto reporter = std::make_unique<BasicErrorReporter>(sources);
+
+    CompilerOptions options;
+    options.optimize = !(flags & NO_OPTIMIZE);
+    options.wholeProgram = false;
+    options.recordBranches = profileOut != nullptr;
+    options.profile = profileIn != nullptr ? &inputProfile : nullptr;
+    options.sources = &sources;
+
+    if(profileOut != nullptr) vm.setProfile(&outputProfile);
+
+    bool stopped = false;
+
+    while(auto batch = queue.pop()){
+        CompilerOptions batchOptions = options;
+        std::unordered_set<std::string_view> outside;
+
+        if(batch->wholeProgram){
+            outside = namesBefore(source, batch->start);
+
+            batchOptions.wholeProgram = true;
+            batchOptions.outside = &outside;
+        }
+
+        Compiler compiler(Compiler::FunctionType::Script, reporter.get(), batchOptions);
+        ObjectFunction function = compiler.compile(batch->program.statements);
+
+        if(reporter->hadError()){
+            for(const auto& error : reporter->errors()){
+                std::cout << error << '\n';
+            }
+
+            stopped = true;
+            break;
+        }
+
+        const InterpreterResult result = vm.execute(&function);
+
+        if(flags & MEMO_STATS){
+            printMemoStats(function);
+        }
+
+        if(result == InterpreterResult::RuntimeError){
+            stopped = true;
+            break;
+        }
+    }
+
+    queue.close();
+    parserThread.join();
+
+    if(!stopped){
+        for(const auto& error : parseErrors->errors()){
+            std::cout << error << '\n';
+        }
+    }
+
+    if(profileOut != nullptr && !outputProfile.save(profileOut)){
+        std::cout << "An error occurred during writing the profile!\n";
+    }
+}
+
+static auto runCode(SourceBuffer source, Short flags) -> void {
     scriptlang::runtime::ObjectFunction function;
 
-    {
-        auto reporter = std::make_unique<BasicErrorReporter>();
+    std::optional<ObjectFunction> compiled;
+
+    // Scripts the single pass gives up on, including those with errors,
+    // go through the parser and the compiler below.
+    if(compilesInOnePass(flags)){
+        SinglePassCompiler compiler(source);
+        compiled = compiler.compile();
+    }
+
+    if(compiled.has_value()){
+        function = std::move(compiled.value());
+    } else {
+        auto reporter = std::make_unique<BasicErrorReporter>(sources);
         Parser parser(source, reporter.get());
 
-        auto ast = parser.parseSoruce();
+        const auto program = parser.parseSoruce();
+        const auto& ast = program.statements;
         if(reporter->hadError()){
 
             for(const auto& error : reporter->errors()){
@@ -67,7 +304,16 @@ static auto runCode(const std::string& source, std::uint8_t flags) -> void {
     
         reporter->reset();
 
-        Compiler compiler(Compiler::FunctionType::Script, reporter.get(), flags & DUMP_BYTECODE);
+        CompilerOptions options;
+        options.debugMode = flags & DUMP_BYTECODE;
+        options.optimize = !(flags & NO_OPTIMIZE);
+        options.inlineReport = flags & INLINE_REPORT;
+        options.wholeProgram = !(flags & INTERACTIVE);
+        options.recordBranches = profileOut != nullptr;
+        options.profile = profileIn != nullptr ? &inputProfile : nullptr;
+        options.sources = &sources;
+
+        Compiler compiler(Compiler::FunctionType::Script, reporter.get(), options);
         function = compiler.compile(ast);
         
         if(reporter->hadError()){
@@ -77,10 +323,70 @@ static auto runCode(const std::string& source, std::uint8_t flags) -> void {
 
             return;
         }
+
+        // The SSA form is only printed, the compiler works on the AST.
+        if(flags & DUMP_IR){
+            Builder builder;
+            scriptlang::ir::print(std::cout, *builder.build(ast));
+        }
     }
 
-    if(flags == EXECUTE){
+    if(!(flags & DUMP)){
+        if(profileOut != nullptr) vm.setProfile(&outputProfile);
+
         vm.execute(&function);
+
+        if(profileOut != nullptr && !outputProfile.save(profileOut)){
+            std::cout << "An error occurred during writing the profile!\n";
+        }
+    }
+
+    if(flags & MEMO_STATS){
+        printMemoStats(function);
+    }
+}
+
+static auto printDiagnostics(const Document& document) -> void {
+
+    const std::vector<Diagnostic> diagnostics = document.diagnostics();
+
+    std::cout << diagnostics.size() << '\n';
+
+    for(const Diagnostic& diagnostic : diagnostics){
+        std::cout << "[Ln: " << diagnostic.line << ", Col: " << diagnostic.column
+                  << "] Error: " << diagnostic.message << '\n';
+    }
+
+    std::cout.flush();
+}
+
+// Keeps the file parsed for an editor. Each edit is read from the standard
+// input as a line `<offset> <length> <size>` followed by `size` bytes that
+// replace `length` bytes at `offset`. The parse errors are printed at the
+// start and after every edit, their count first.
+static auto runServer(const char* filename) -> void {
+
+    Document document(readSourceFromFile(filename));
+    printDiagnostics(document);
+
+    std::size_t offset, length, size;
+
+    while(std::cin >> offset >> length >> size && std::cin.get() == '\n'){
+        std::string text(size, '\0');
+
+        if(size != 0 && !std::cin.read(&text[0], size)) break;
+
+        const std::size_t documentSize = document.text().size();
+
+        if(offset > documentSize || length > documentSize - offset ||
+           documentSize - length + size > UINT32_MAX){
+            std::cout << "An error occurred during reading the edit!\n";
+            std::cout.flush();
+            continue;
+        }
+
+        document.edit(static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(length), text);
+        printDiagnostics(document);
     }
 }
 
@@ -123,18 +429,21 @@ static auto repl() -> void {
             continue;
         }
 
-        std::uint8_t flags = EXECUTE;
+        Short flags = INTERACTIVE;
         
         if(astDump) flags |= DUMP_AST;
         if(bytecodeDump) flags |= DUMP_BYTECODE;
 
-        runCode(line, flags);
+        runCode(sources.add(line), flags);
     }
 }
 
-static inline auto runFromFile(const char* filename, bool dump) -> void {
-    std::string source = readSourceFromFile(filename);
-    runCode(source, dump ? (DUMP_AST | DUMP_BYTECODE) : EXECUTE);
+static inline auto runFromFile(const char* filename, Short flags) -> void {
+    const SourceBuffer source = sources.add(readSourceFromFile(filename));
+
+    runsPipelined(flags)
+        ? runPipelined(source, flags)
+        : runCode(source, flags);
 }
 
 static auto usage(const char* program) -> void {
@@ -142,7 +451,16 @@ static auto usage(const char* program) -> void {
     std::cout << "Usage: " << program << " [Options] [Source files]\n\n"
         << "Options:\n"
         << "\t--help\tPrint the usage of the program.\n"
-        << "\t--dump\tPrint the generated AST and Bytecode.\n";
+        << "\t--dump\tPrint the generated AST and Bytecode.\n"
+        << "\t--inline-report\tPrint the inlining decisions of the compiler.\n"
+        << "\t--no-optimize\tCompile the program without any optimization.\n"
+        << "\t--dump-ir\tPrint the SSA form of the program, for debugging.\n"
+        << "\t--single-pass\tCompile straight from the tokens without the AST or optimizations, for scripts run once.\n"
+        << "\t--pipeline\tParse on a separate thread and run each top-level statement once it is parsed.\n"
+        << "\t--server\tKeep the source parsed and print its parse errors after each edit read from the standard input.\n"
+        << "\t--memo-stats\tPrint the cache statistics of the @memo functions after the run.\n"
+        << "\t--profile-out <file>\tRecord call counts and branch directions, added to the file.\n"
+        << "\t--profile-in <file>\tOptimize with the counts recorded in the file.\n";
 
     printReplCommands();
 
@@ -151,7 +469,9 @@ static auto usage(const char* program) -> void {
 
 auto main(int argc, char** argv) -> int {
 
-    bool shouldDump = false;
+    Short flags = EXECUTE;
+
+    vm.setSourceManager(&sources);
 
     if(argc == 1){
         repl();
@@ -169,11 +489,45 @@ auto main(int argc, char** argv) -> int {
             usage(argv[0]);
             std::exit(EXIT_SUCCESS);
         } else if(std::strcmp(*args, "--dump") == 0){
-            shouldDump = true;
+            flags |= DUMP;
+        } else if(std::strcmp(*args, "--inline-report") == 0){
+            flags |= INLINE_REPORT;
+        } else if(std::strcmp(*args, "--no-optimize") == 0){
+            flags |= NO_OPTIMIZE;
+        } else if(std::strcmp(*args, "--dump-ir") == 0){
+            flags |= DUMP_IR;
+        } else if(std::strcmp(*args, "--memo-stats") == 0){
+            flags |= MEMO_STATS;
+        } else if(std::strcmp(*args, "--single-pass") == 0){
+            flags |= SINGLE_PASS;
+        } else if(std::strcmp(*args, "--pipeline") == 0){
+            flags |= PIPELINE;
+        } else if(std::strcmp(*args, "--server") == 0){
+            flags |= SERVER;
+        } else if(std::strcmp(*args, "--profile-out") == 0 && args[1] != nullptr){
+            profileOut = *(++args);
+        } else if(std::strcmp(*args, "--profile-in") == 0 && args[1] != nullptr){
+            profileIn = *(++args);
         }
     }
 
-    runFromFile(*args, shouldDump);
+    if(profileIn != nullptr && !inputProfile.load(profileIn)){
+        std::cout << "An error occurred during reading the profile!\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // A missing output profile starts empty, a malformed one is kept.
+    if(profileOut != nullptr && std::ifstream(profileOut).good() && !outputProfile.load(profileOut)){
+        std::cout << "An error occurred during reading the profile!\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    if(flags & SERVER){
+        runServer(*args);
+        return 0;
+    }
+
+    runFromFile(*args, flags);
     
     return 0;
 }
@@ -0,0 +1,144 @@
+#include "../include/memo.h"
+
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+namespace scriptlang::runtime {
+
+// Integers and doubles are different keys even when equal, a function
+// may compute different results from them. Doubles compare bitwise.
+static auto doubleBits(const Value& value) -> std::uint64_t {
+    const double number = value.asNumber();
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+
+    return bits;
+}
+
+static auto hashValue(const Value& value) -> std::size_t {
+
+    if(value.isInteger()) return std::hash<std::int64_t>()(value.asInteger());
+    if(value.isNumber()) return std::hash<std::uint64_t>()(doubleBits(value)) ^ 0x5bd1e995;
+    if(value.isString()) return std::hash<std::string>()(value.asString());
+    if(value.isBoolean()) return value.asBoolean() ? 1 : 2;
+
+    return 0;
+}
+
+static auto sameValue(const Value& lhs, const Value& rhs) -> bool {
+
+    if(lhs.isInteger() || rhs.isInteger()){
+        return lhs.isInteger() && rhs.isInteger() && lhs.asInteger() == rhs.asInteger();
+    }
+
+    if(lhs.isNumber() || rhs.isNumber()){
+        return lhs.isNumber() && rhs.isNumber() && doubleBits(lhs) == doubleBits(rhs);
+    }
+
+    if(lhs.isString() || rhs.isString()){
+        return lhs.isString() && rhs.isString() && lhs.asString() == rhs.asString();
+    }
+
+    if(lhs.isBoolean() || rhs.isBoolean()){
+        return lhs.isBoolean() && rhs.isBoolean() && lhs.asBoolean() == rhs.asBoolean();
+    }
+
+    return lhs.isNil() && rhs.isNil();
+}
+
+static auto hashKey(const Value* args, int argc) -> std::size_t {
+
+    std::size_t hash = static_cast<std::size_t>(argc);
+
+    for(int i = 0; i < argc; i++){
+        hash ^= hashValue(args[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+
+    return hash;
+}
+
+auto MemoCache::isKey(const Value* args, int argc) -> bool {
+
+    for(int i = 0; i < argc; i++){
+        if(args[i].isFunction()) return false;
+    }
+
+    return true;
+}
+
+auto MemoCache::find(const Value* args, int argc) -> const Value* {
+
+    const auto entry = lookup(args, argc, hashKey(args, argc));
+
+    if(entry == entries_.end()){
+        misses_++;
+        return nullptr;
+    }
+
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, entry);
+
+    return &entry->result;
+}
+
+auto MemoCache::insert(std::vector<Value> key, Value result) -> void {
+
+    const int argc = static_cast<int>(key.size());
+    const std::size_t hash = hashKey(key.data(), argc);
+
+    // A recursive call with the same arguments may have stored it already.
+    const auto entry = lookup(key.data(), argc, hash);
+
+    if(entry != entries_.end()){
+        entry->result = std::move(result);
+        entries_.splice(entries_.begin(), entries_, entry);
+        return;
+    }
+
+    if(entries_.size() == capacity_){
+        evict();
+    }
+
+    entries_.push_front({std::move(key), hash, std::move(result)});
+    index_.emplace(hash, entries_.begin());
+}
+
+auto MemoCache::lookup(const Value* args, int argc, std::size_t hash) -> Entries::iterator {
+
+    auto [it, end] = index_.equal_range(hash);
+
+    for(; it != end; it++){
+        const std::vector<Value>& key = it->second->key;
+
+        if(static_cast<int>(key.size()) != argc) continue;
+
+        bool same = true;
+        for(int i = 0; i < argc && same; i++){
+            same = sameValue(key[i], args[i]);
+        }
+
+        if(same) return it->second;
+    }
+
+    return entries_.end();
+}
+
+auto MemoCache::evict() -> void {
+
+    const auto last = std::prev(entries_.end());
+    auto [it, end] = index_.equal_range(last->hash);
+
+    for(; it != end; it++){
+        if(it->second == last){
+            index_.erase(it);
+            break;
+        }
+    }
+
+    entries_.erase(last);
+    evictions_++;
+}
+
+}
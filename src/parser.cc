@@ -1,6 +1,7 @@
 #include "../include/parser.h"
 #include "../include/utils.h"
 
+#include <charconv>
 #include <cstdio>
 #include <cmath>
 #include <functional>
@@ -11,12 +12,29 @@ namespace scriptlang::parser {
 
 using namespace utils;
 
-Parser::Parser(std::string_view source, ErrorReporter* reporter)
+Parser::Parser(SourceBuffer source, ErrorReporter* reporter)
     : lex_(source),
+      arena_(std::make_unique<Arena>()),
       reporter_(reporter){
     advance(); // get first token
+}
+
+constexpr auto Parser::makeParseRules() -> ParseRules {
+
+    ParseRules rules {};
+
+    const auto registerRule = [&rules](TokenType type, Precedence prec,
+                                       ParsePrefix prefix, ParseInfix infix){
+        rules[static_cast<std::size_t>(type)] = {prec, infix, prefix};
+    };
 
-    // Register parser rules
+    const auto registerInfix = [&registerRule](TokenType type, Precedence prec, ParseInfix infix){
+        registerRule(type, prec, nullptr, infix);
+    };
+
+    const auto registerPrefix = [&registerRule](TokenType type, Precedence prec, ParsePrefix prefix){
+        registerRule(type, prec, prefix, nullptr);
+    };
 
     registerInfix(TokenType::Assign, Precedence::Assignment, &Parser::assignmentExpression);
     registerInfix(TokenType::Slash, Precedence::Factor, &Parser::binaryExpression);
@@ -41,13 +59,18 @@ Parser::Parser(std::string_view source, ErrorReporter* reporter)
 
     registerPrefix(TokenType::Identifier, Precedence::Primary, &Parser::primaryExpression);
     registerPrefix(TokenType::NumberLiteral, Precedence::Primary, &Parser::primaryExpression);
+    registerPrefix(TokenType::IntegerLiteral, Precedence::Primary, &Parser::primaryExpression);
     registerPrefix(TokenType::StringLiteral, Precedence::Primary, &Parser::primaryExpression);
     registerPrefix(TokenType::TrueKeyword, Precedence::Primary, &Parser::primaryExpression);
     registerPrefix(TokenType::FalseKeyword, Precedence::Primary, &Parser::primaryExpression);
     registerPrefix(TokenType::NilKeyword, Precedence::Primary, &Parser::primaryExpression);
+
+    return rules;
 }
 
-auto Parser::parseSoruce() -> std::vector<StatementPtr> {
+constexpr Parser::ParseRules Parser::rules_ = makeParseRules();
+
+auto Parser::parseSoruce() -> Program {
 
     std::vector<StatementPtr> statements;
 
@@ -61,7 +84,29 @@ auto Parser::parseSoruce() -> std::vector<StatementPtr> {
         }
     }
 
-    return statements;
+    const StatementList program = arena_->copy(statements);
+    return Program { std::move(arena_), program };
+}
+
+auto Parser::parseDeclarations(std::size_t count) -> Program {
+
+    std::vector<StatementPtr> statements;
+
+    while(!isAtEnd() && statements.size() < count) {
+        start_ = peek();
+
+        statements.push_back(declaration());
+
+        if(panicMode_){
+            synchronize();
+        }
+    }
+
+    const StatementList program = arena_->copy(statements);
+    Program declarations { std::move(arena_), program };
+
+    arena_ = std::make_unique<Arena>();
+    return declarations;
 }
 
 auto Parser::declaration() -> StatementPtr {
@@ -70,6 +115,8 @@ auto Parser::declaration() -> StatementPtr {
         return variableDeclaration();
     } else if(match(TokenType::DefunKeyword)) {
         return functionDeclaration();
+    } else if(match(TokenType::At)) {
+        return annotatedDeclaration();
     }
 
     return statement();
@@ -79,17 +126,40 @@ auto Parser::variableDeclaration() -> StatementPtr {
     auto name = consume(TokenType::Identifier, "Expect variable name after 'let' keyword.");
     
     if(!name.has_value()) return nullptr;
+
+    const TypeAnnotation annotation = typeAnnotation();
     
     consume(TokenType::Assign, "Expect '=' after variable name.");
     ExpressionPtr initializer = expression();
     consume(TokenType::Semicolon, "Expect ';' at end of let statement.");
 
-    return makeStatement<VariableDeclaration>(currentSourceRange(), name.value(), initializer);
+    return makeStatement<VariableDeclaration>(*arena_, currentSourceRange(), name.value(), initializer, annotation);
 }
 
-auto Parser::functionDeclaration() -> StatementPtr {
+auto Parser::annotatedDeclaration() -> StatementPtr {
+
+    parsedAnnotations_ = true;
+
+    auto annotation = consume(TokenType::Identifier, "Expect annotation name after '@'.");
+    if(!annotation.has_value()) return nullptr;
+
+    if(annotation->lexeme != "memo"){
+        error("Unknown annotation '%.*s', expect 'memo'.",
+              static_cast<int>(annotation->lexeme.size()), annotation->lexeme.data());
+        return nullptr;
+    }
+
+    if(!consume(TokenType::DefunKeyword, "Expect 'defun' after annotation.").has_value()){
+        return nullptr;
+    }
+
+    return functionDeclaration(true);
+}
+
+auto Parser::functionDeclaration(bool memoized) -> StatementPtr {
 
     std::vector<Token> parameters;
+    std::vector<TypeAnnotation> annotations;
     
     auto name = consume(TokenType::Identifier, "Expect function name after 'defun' keyword.");
     if(!name.has_value()) return nullptr;
@@ -102,6 +172,7 @@ auto Parser::functionDeclaration() -> StatementPtr {
             if(!param.has_value()) return nullptr;
 
             parameters.push_back(param.value());
+            annotations.push_back(typeAnnotation());
         } while(match(TokenType::Comma));
 
         consume(TokenType::RightParen, "Expect ')' after parameters.");
@@ -110,7 +181,28 @@ auto Parser::functionDeclaration() -> StatementPtr {
     consume(TokenType::LeftBrace, "Expect '{' before function body.");
     StatementPtr body = block();
 
-    return makeStatement<FunctionDeclaration>(currentSourceRange(), name.value(), parameters, body);
+    return makeStatement<FunctionDeclaration>(*arena_, currentSourceRange(), name.value(),
+                                              arena_->copy(parameters), arena_->copy(annotations),
+                                              body, memoized);
+}
+
+auto Parser::typeAnnotation() -> TypeAnnotation {
+
+    if(!match(TokenType::Colon)) return TypeAnnotation::None;
+
+    parsedAnnotations_ = true;
+
+    auto type = consume(TokenType::Identifier, "Expect type name after ':'.");
+    if(!type.has_value()) return TypeAnnotation::None;
+
+    if(type->lexeme == "num") return TypeAnnotation::Number;
+    if(type->lexeme == "str") return TypeAnnotation::String;
+    if(type->lexeme == "bool") return TypeAnnotation::Boolean;
+
+    error("Unknown type '%.*s', expect 'num', 'str' or 'bool'.",
+          static_cast<int>(type->lexeme.size()), type->lexeme.data());
+
+    return TypeAnnotation::None;
 }
 
 auto Parser::statement() -> StatementPtr {
@@ -120,6 +212,10 @@ auto Parser::statement() -> StatementPtr {
         return ifStatement();
     } else if(match(TokenType::WhileKeyword)){
         return whileStatement();
+    } else if(match(TokenType::ForKeyword)){
+        return forStatement();
+    } else if(match(TokenType::MatchKeyword)){
+        return matchStatement();
     } else if(match(TokenType::PrintKeyword)) {
         return printStatement();
     } else if(match(TokenType::ReturnKeyword)) {
@@ -144,7 +240,7 @@ auto Parser::block() -> StatementPtr {
 
     consume(TokenType::RightBrace, "Expect '}' after block.");
    
-    return makeStatement<Block>(currentSourceRange(), statements);
+    return makeStatement<Block>(*arena_, currentSourceRange(), arena_->copy(statements));
 }
 
 auto Parser::whileStatement() -> StatementPtr {
@@ -153,9 +249,29 @@ auto Parser::whileStatement() -> StatementPtr {
     consume(TokenType::LeftBrace, "Expect '{' before then branch.");
     StatementPtr body = block();
     
-    return makeStatement<WhileStatement>(currentSourceRange(), condition, body);
+    return makeStatement<WhileStatement>(*arena_, currentSourceRange(), condition, body);
 }
 
+auto Parser::forStatement() -> StatementPtr {
+    auto variable = consume(TokenType::Identifier, "Expect loop variable name after 'for' keyword.");
+    if(!variable.has_value()) return nullptr;
+
+    consume(TokenType::Assign, "Expect '=' after loop variable name.");
+    ExpressionPtr start = expression();
+
+    consume(TokenType::Comma, "Expect ',' after loop start value.");
+    ExpressionPtr limit = expression();
+
+    ExpressionPtr step = nullptr;
+    if(match(TokenType::Comma)){
+        step = expression();
+    }
+
+    consume(TokenType::LeftBrace, "Expect '{' before loop body.");
+    StatementPtr body = block();
+
+    return makeStatement<ForStatement>(*arena_, currentSourceRange(), variable.value(), start, limit, step, body);
+}
     
 auto Parser::ifStatement() -> StatementPtr {
     ExpressionPtr condition = expression();
@@ -169,24 +285,82 @@ auto Parser::ifStatement() -> StatementPtr {
         elseBranch = block();
     }
 
-    return makeStatement<IfStatement>(currentSourceRange(), condition, thenBranch, elseBranch);
+    return makeStatement<IfStatement>(*arena_, currentSourceRange(), condition, thenBranch, elseBranch);
+}
+
+auto Parser::matchStatement() -> StatementPtr {
+    ExpressionPtr subject = expression();
+
+    consume(TokenType::LeftBrace, "Expect '{' after match subject.");
+
+    std::vector<MatchArm> arms;
+    StatementPtr elseBranch = nullptr;
+
+    while(!check(TokenType::RightBrace) && !isAtEnd()){
+        if(match(TokenType::ElseKeyword)){
+            consume(TokenType::LeftBrace, "Expect '{' before else arm.");
+            elseBranch = block();
+            break;
+        }
+
+        std::vector<ExpressionPtr> labels;
+
+        do{
+            ExpressionPtr label = matchLabel();
+            if(label == nullptr) return nullptr;
+
+            labels.push_back(std::move(label));
+        } while(match(TokenType::Comma));
+
+        consume(TokenType::LeftBrace, "Expect '{' before match arm.");
+        StatementPtr body = block();
+
+        arms.push_back(MatchArm { arena_->copy(labels), body });
+    }
+
+    consume(TokenType::RightBrace, "Expect '}' after match arms.");
+
+    return makeStatement<MatchStatement>(*arena_, currentSourceRange(), subject, arena_->copy(arms), elseBranch);
+}
+
+auto Parser::matchLabel() -> ExpressionPtr {
+    const bool negative = match(TokenType::Minus);
+
+    if(match(TokenType::IntegerLiteral) || (!negative && match(TokenType::StringLiteral))){
+        ExpressionPtr label = primaryExpression();
+        const auto literal = static_cast<LiteralExpression*>(label.get());
+
+        if(literal->isNumber() && !literal->isInteger()){
+            error("Integer 'match' case out of range.");
+            return nullptr;
+        }
+
+        if(negative){
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), -literal->asInteger());
+        }
+
+        return label;
+    }
+
+    error("Expect an integer or string literal as 'match' case.");
+    return nullptr;
 }
 
 auto Parser::expressionStatement() -> StatementPtr {
     ExpressionPtr expr = expression();
     consume(TokenType::Semicolon, "Expect ';' after expression.");
 
-    return makeStatement<ExpressionStatement>(currentSourceRange(), expr);
+    return makeStatement<ExpressionStatement>(*arena_, currentSourceRange(), expr);
 }
 
 auto Parser::continueStatement() -> StatementPtr {
     consume(TokenType::Semicolon, "Expect ';' after continue statement.");
-    return makeStatement<ContinueStatement>(currentSourceRange());
+    return makeStatement<ContinueStatement>(*arena_, currentSourceRange());
 }
 
 auto Parser::breakStatement() -> StatementPtr {
     consume(TokenType::Semicolon, "Expect ';' after break statement.");
-    return makeStatement<BreakStatement>(currentSourceRange());
+    return makeStatement<BreakStatement>(*arena_, currentSourceRange());
 }
 
 auto Parser::returnStatement() -> StatementPtr {
@@ -197,30 +371,28 @@ auto Parser::returnStatement() -> StatementPtr {
     }
 
     consume(TokenType::Semicolon, "Expect ';' at end of return statement.");
-    return makeStatement<ReturnStatement>(currentSourceRange(), return_value);
+    return makeStatement<ReturnStatement>(*arena_, currentSourceRange(), return_value);
 }
 
 auto Parser::printStatement() -> StatementPtr {
     ExpressionPtr expr = expression();
     consume(TokenType::Semicolon, "Expect ';' at end of print statement.");
     
-    return makeStatement<PrintStatement>(currentSourceRange(), expr);
+    return makeStatement<PrintStatement>(*arena_, currentSourceRange(), expr);
 }
 
-auto Parser::getParseRules(TokenType type) -> ParseRule {
-    try {
-        return rules_.at(type);
-    } catch(...) {
-    }
+auto Parser::parsePrecedence(Precedence prec) -> ExpressionPtr {
 
-    return {Precedence::None, nullptr,  nullptr };
-}
+    // advance() stays on the last token at the end, its prefix rule would
+    // parse it again and again.
+    if(isAtEnd()){
+        error("Expect an expression.");
+        return nullptr;
+    }
 
-auto Parser::parsePrecedence(Precedence prec) -> ExpressionPtr {
     advance();
-    Token op = previous();
 
-    ParsePrefix prefix = getParseRules(op.type).prefix;
+    ParsePrefix prefix = getParseRules(previous().type).prefix;
 
     if(nullptr == prefix){
         error("Expect an expression.");
@@ -231,9 +403,8 @@ auto Parser::parsePrecedence(Precedence prec) -> ExpressionPtr {
 
     while(prec < getParseRules(peek().type).prec){
         advance();
-        op = previous();
 
-        ParseInfix infix = getParseRules(op.type).infix;
+        ParseInfix infix = getParseRules(previous().type).infix;
 
         if(infix == nullptr) break;
         left = std::invoke(infix, this, left);
@@ -259,7 +430,7 @@ auto Parser::assignmentExpression(ExpressionPtr& left) -> ExpressionPtr {
 
     const auto expr = static_cast<VariableExpression*>(left.get());
 
-    return makeExpression<AssignmentExpression>(currentSourceRange(), expr->name(), right);
+    return makeExpression<AssignmentExpression>(*arena_, currentSourceRange(), expr->name(), right);
 }
 
 auto Parser::binaryExpression(ExpressionPtr& left) -> ExpressionPtr {
@@ -268,13 +439,13 @@ auto Parser::binaryExpression(ExpressionPtr& left) -> ExpressionPtr {
     auto precedence = static_cast<Precedence>(getParseRules(op.type).prec);
     ExpressionPtr right = parsePrecedence(precedence);
 
-    return makeExpression<BinaryExpression>(currentSourceRange(), op, left, right);
+    return makeExpression<BinaryExpression>(*arena_, currentSourceRange(), op, left, right);
 }
 
 auto Parser::unaryExpression() -> ExpressionPtr {
     Token op = previous();
     ExpressionPtr right = parsePrecedence(Precedence::Unary);
-    return makeExpression<UnaryExpression>(currentSourceRange(), op, right);
+    return makeExpression<UnaryExpression>(*arena_, currentSourceRange(), op, right);
 }
 
 auto Parser::callExpression(ExpressionPtr& left) -> ExpressionPtr {
@@ -296,33 +467,45 @@ auto Parser::callExpression(ExpressionPtr& left) -> ExpressionPtr {
         consume(TokenType::RightParen, "Expect ')' after arguments.");
     }
 
-    return makeExpression<CallExpression>(currentSourceRange(), left, args);
+    return makeExpression<CallExpression>(*arena_, currentSourceRange(), left, arena_->copy(args));
 }
 
 auto Parser::primaryExpression() -> ExpressionPtr {
-    Token token = previous();
+    const Token& token = previous();
 
     switch(token.type) {
         case TokenType::LeftParen: {
             ExpressionPtr expr = expression();
             consume(TokenType::RightParen, "Expect ')' after a grouping expression.");
-            return makeExpression<GroupingExpression>(currentSourceRange(), expr);
+            return makeExpression<GroupingExpression>(*arena_, currentSourceRange(), expr);
         }
         case TokenType::StringLiteral:
-            return makeExpression<LiteralExpression>(currentSourceRange(), 
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), 
                                                      token.lexeme.substr(1, token.lexeme.size() - 2));
         case TokenType::NumberLiteral: {
             double number = std::strtod(token.lexeme.data(), nullptr);
-            return makeExpression<LiteralExpression>(currentSourceRange(), number);
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), number);
+        }
+        case TokenType::IntegerLiteral: {
+            std::int64_t integer;
+            const char* end = token.lexeme.data() + token.lexeme.size();
+
+            // Too large for 64 bits, keep the closest double instead.
+            if(std::from_chars(token.lexeme.data(), end, integer).ec != std::errc()){
+                double number = std::strtod(token.lexeme.data(), nullptr);
+                return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), number);
+            }
+
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), integer);
         }
         case TokenType::TrueKeyword:
-            return makeExpression<LiteralExpression>(currentSourceRange(), true);
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), true);
         case TokenType::FalseKeyword:
-            return makeExpression<LiteralExpression>(currentSourceRange(), false);
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange(), false);
         case TokenType::Identifier:
-            return makeExpression<VariableExpression>(currentSourceRange(), token);
+            return makeExpression<VariableExpression>(*arena_, currentSourceRange(), token);
         case TokenType::NilKeyword:
-            return makeExpression<LiteralExpression>(currentSourceRange());
+            return makeExpression<LiteralExpression>(*arena_, currentSourceRange());
         default:
             break;
     }
@@ -348,8 +531,14 @@ auto Parser::error(const char* fmt, Args&&... args) -> void {
 
 auto Parser::synchronize() -> void {
 
+    // Cleared before the next declaration, which then parses the same as
+    // it would at the start of a source.
+    panicMode_ = false;
+
     while(!isAtEnd()){
         switch(peek().type){
+            case TokenType::At:
+                [[fallthrough]];
             case TokenType::DefunKeyword:
                 [[fallthrough]];
             case TokenType::LetKeyword:
@@ -358,6 +547,10 @@ auto Parser::synchronize() -> void {
                 [[fallthrough]];
             case TokenType::WhileKeyword:
                 [[fallthrough]];
+            case TokenType::ForKeyword:
+                [[fallthrough]];
+            case TokenType::MatchKeyword:
+                [[fallthrough]];
             case TokenType::BreakKeyword:
                 [[fallthrough]];
             case TokenType::ContinueKeyword:
@@ -369,8 +562,6 @@ auto Parser::synchronize() -> void {
                 break;
         }
     }
-    
-    panicMode_ = false;
 }
 
 auto Parser::advance() -> void {
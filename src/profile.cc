@@ -0,0 +1,97 @@
+#include "../include/profile.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace scriptlang::runtime {
+
+static constexpr const char* MAGIC = "scriptlang-profile";
+
+auto Profile::load(const std::string& path) -> bool {
+
+    std::ifstream stream(path);
+    if(!stream.is_open()) return false;
+
+    std::string magic;
+    int version = 0;
+
+    if(!(stream >> magic >> version) || magic != MAGIC || version != VERSION){
+        return false;
+    }
+
+    // Parsed aside, a malformed file leaves the profile untouched.
+    Profile parsed;
+    std::string line;
+
+    std::getline(stream, line);
+
+    while(std::getline(stream, line)){
+        if(line.empty()) continue;
+
+        std::istringstream record(line);
+        std::string kind;
+        record >> kind;
+
+        if(kind == "call"){
+            std::string name;
+            std::uint64_t count;
+
+            if(!(record >> name >> count)) return false;
+            parsed.calls_[name] += count;
+        } else if(kind == "branch"){
+            std::uint32_t row, column;
+            BranchCounts counts;
+
+            if(!(record >> row >> column >> counts.whenTrue >> counts.whenFalse)) return false;
+
+            BranchCounts& into = parsed.branches_[{row, column}];
+            into.whenTrue += counts.whenTrue;
+            into.whenFalse += counts.whenFalse;
+        } else {
+            return false;
+        }
+    }
+
+    for(const auto& [name, count] : parsed.calls_){
+        calls_[name] += count;
+    }
+
+    for(const auto& [position, counts] : parsed.branches_){
+        BranchCounts& into = branches_[position];
+        into.whenTrue += counts.whenTrue;
+        into.whenFalse += counts.whenFalse;
+    }
+
+    return true;
+}
+
+auto Profile::save(const std::string& path) const -> bool {
+
+    std::ofstream stream(path);
+    if(!stream.is_open()) return false;
+
+    stream << MAGIC << ' ' << VERSION << '\n';
+
+    for(const auto& [name, count] : calls_){
+        stream << "call " << name << ' ' << count << '\n';
+    }
+
+    for(const auto& [position, counts] : branches_){
+        stream << "branch " << position.first << ' ' << position.second << ' '
+               << counts.whenTrue << ' ' << counts.whenFalse << '\n';
+    }
+
+    return stream.good();
+}
+
+auto Profile::calls(const std::string& function) const -> std::uint64_t {
+    const auto it = calls_.find(function);
+    return it != calls_.end() ? it->second : 0;
+}
+
+auto Profile::branch(std::uint32_t line, std::uint32_t column) const -> const BranchCounts* {
+    const auto it = branches_.find({line, column});
+    return it != branches_.end() ? &it->second : nullptr;
+}
+
+}
@@ -0,0 +1,942 @@
+#include "../include/single_pass.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <utility>
+
+namespace scriptlang::compiler {
+
+SinglePassCompiler::SinglePassCompiler(SourceBuffer source)
+    : source_(source), lex_(source) {
+    advance(); // get first token
+}
+
+constexpr auto SinglePassCompiler::makeParseRules() -> ParseRules {
+
+    ParseRules rules {};
+
+    const auto registerRule = [&rules](TokenType type, Precedence prec,
+                                       ParsePrefix prefix, ParseInfix infix){
+        rules[static_cast<std::size_t>(type)] = {prec, infix, prefix};
+    };
+
+    const auto registerInfix = [&registerRule](TokenType type, Precedence prec, ParseInfix infix){
+        registerRule(type, prec, nullptr, infix);
+    };
+
+    const auto registerPrefix = [&registerRule](TokenType type, Precedence prec, ParsePrefix prefix){
+        registerRule(type, prec, prefix, nullptr);
+    };
+
+    // Same table as the Parser's, precedences of tokens without an infix
+    // rule included: they end an expression the same way.
+    registerInfix(TokenType::Assign, Precedence::Assignment, &SinglePassCompiler::assignmentExpression);
+    registerInfix(TokenType::Slash, Precedence::Factor, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::Star, Precedence::Factor, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::Exponent, Precedence::Exponent, &SinglePassCompiler::binaryExpression);
+
+    registerInfix(TokenType::Less, Precedence::Comparison, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::Greater, Precedence::Comparison, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::GreaterEqual, Precedence::Comparison, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::LessEqual, Precedence::Comparison, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::NotEqual, Precedence::Equality, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::Equal, Precedence::Equality, &SinglePassCompiler::binaryExpression);
+
+    registerInfix(TokenType::AndKeyword, Precedence::LogicAnd, &SinglePassCompiler::binaryExpression);
+    registerInfix(TokenType::OrKeyword, Precedence::LogicOr, &SinglePassCompiler::binaryExpression);
+
+    registerRule(TokenType::Plus, Precedence::Term, &SinglePassCompiler::unaryExpression, &SinglePassCompiler::binaryExpression);
+    registerRule(TokenType::Minus, Precedence::Term, &SinglePassCompiler::unaryExpression, &SinglePassCompiler::binaryExpression);
+    registerRule(TokenType::LeftParen, Precedence::Call, &SinglePassCompiler::groupingExpression, &SinglePassCompiler::callExpression);
+
+    registerPrefix(TokenType::NotKeyword, Precedence::Unary, &SinglePassCompiler::unaryExpression);
+
+    registerPrefix(TokenType::Identifier, Precedence::Primary, &SinglePassCompiler::variableExpression);
+    registerPrefix(TokenType::NumberLiteral, Precedence::Primary, &SinglePassCompiler::literalExpression);
+    registerPrefix(TokenType::IntegerLiteral, Precedence::Primary, &SinglePassCompiler::literalExpression);
+    registerPrefix(TokenType::StringLiteral, Precedence::Primary, &SinglePassCompiler::literalExpression);
+    registerPrefix(TokenType::TrueKeyword, Precedence::Primary, &SinglePassCompiler::literalExpression);
+    registerPrefix(TokenType::FalseKeyword, Precedence::Primary, &SinglePassCompiler::literalExpression);
+    registerPrefix(TokenType::NilKeyword, Precedence::Primary, &SinglePassCompiler::literalExpression);
+
+    return rules;
+}
+
+constexpr SinglePassCompiler::ParseRules SinglePassCompiler::rules_ = makeParseRules();
+
+auto SinglePassCompiler::compile() -> std::optional<ObjectFunction> {
+
+    FunctionState script(nullptr, FunctionType::Script);
+
+    current_ = &script;
+
+    while(!isAtEnd() && !failed_){
+        position_ = peek().position.start.offset;
+        declaration();
+    }
+
+    emit(OpCode::Nil);
+    emit(OpCode::Return);
+
+    current_ = nullptr;
+
+    if(failed_) return std::nullopt;
+
+    return std::move(script.function);
+}
+
+auto SinglePassCompiler::declaration() -> void {
+
+    if(match(TokenType::LetKeyword)){
+        variableDeclaration();
+    } else if(match(TokenType::DefunKeyword)){
+        functionDeclaration();
+    } else if(check(TokenType::At)){
+        // `@memo` needs the purity proof of the whole program.
+        fail();
+    } else {
+        statement();
+    }
+}
+
+auto SinglePassCompiler::variableDeclaration() -> void {
+
+    if(!consume(TokenType::Identifier)) return;
+    const std::string_view name = previous().lexeme;
+
+    typeAnnotation();
+    declareVariable(name);
+
+    consume(TokenType::Assign);
+    expression();
+    consume(TokenType::Semicolon);
+
+    defineVariable(name);
+}
+
+auto SinglePassCompiler::functionDeclaration() -> void {
+
+    if(current_->type == FunctionType::Function){
+        fail();
+        return;
+    }
+
+    if(!consume(TokenType::Identifier)) return;
+    const std::string_view name = previous().lexeme;
+
+    FunctionState function(current_, FunctionType::Function);
+    function.function.name = name;
+    function.skimmed = true;
+
+    const std::uint32_t start = peek().position.start.offset;
+
+    current_ = &function;
+    functionBody();
+    current_ = function.enclosing;
+
+    if(failed_) return;
+
+    const std::uint32_t end = previous().position.end.offset;
+
+    const SourceBuffer body {
+        source_.text.substr(start - source_.start, end - start),
+        start
+    };
+
+    function.function.lazy = std::make_shared<LazyBody>();
+    function.function.lazy->compile = [body, position = position_](){
+        return compileBody(body, position);
+    };
+
+    emit(OpCode::PushConstant);
+    emit(makeConstant(std::move(function.function)));
+
+    defineVariable(name);
+}
+
+auto SinglePassCompiler::compileBody(SourceBuffer source, std::uint32_t position) -> std::optional<Chunk> {
+
+    SinglePassCompiler compiler(source);
+    compiler.position_ = position;
+
+    FunctionState function(nullptr, FunctionType::Function);
+
+    compiler.current_ = &function;
+    compiler.functionBody();
+    compiler.current_ = nullptr;
+
+    if(compiler.failed_) return std::nullopt;
+
+    return std::move(function.function.chunk);
+}
+
+auto SinglePassCompiler::functionBody() -> void {
+
+    beginScope();
+
+    consume(TokenType::LeftParen);
+
+    int arity = 0;
+
+    if(!match(TokenType::RightParen)){
+        do{
+            if(!consume(TokenType::Identifier)) break;
+
+            declareVariable(previous().lexeme);
+            defineVariable(previous().lexeme);
+            arity++;
+
+            typeAnnotation();
+        } while(match(TokenType::Comma) && !failed_);
+
+        consume(TokenType::RightParen);
+    }
+
+    consume(TokenType::LeftBrace);
+    block();
+
+    emit(OpCode::Nil);
+    emit(OpCode::Return);
+
+    current_->function.arity = arity;
+}
+
+auto SinglePassCompiler::typeAnnotation() -> void {
+    // Annotations of globals apply to every assignment, even in functions
+    // compiled before the declaration.
+    if(check(TokenType::Colon)) fail();
+}
+
+auto SinglePassCompiler::statement() -> void {
+
+    if(match(TokenType::IfKeyword)){
+        ifStatement();
+    } else if(match(TokenType::WhileKeyword)){
+        whileStatement();
+    } else if(match(TokenType::ForKeyword)){
+        forStatement();
+    } else if(match(TokenType::MatchKeyword)){
+        matchStatement();
+    } else if(match(TokenType::PrintKeyword)){
+        printStatement();
+    } else if(match(TokenType::ReturnKeyword)){
+        returnStatement();
+    } else if(match(TokenType::ContinueKeyword)){
+        continueStatement();
+    } else if(match(TokenType::BreakKeyword)){
+        breakStatement();
+    } else if(match(TokenType::LeftBrace)){
+        scopedBlock();
+    } else {
+        expressionStatement();
+    }
+}
+
+auto SinglePassCompiler::block() -> void {
+
+    while(!check(TokenType::RightBrace) && !isAtEnd() && !failed_){
+        declaration();
+    }
+
+    consume(TokenType::RightBrace);
+}
+
+auto SinglePassCompiler::scopedBlock() -> void {
+    beginScope();
+    block();
+    endScope();
+}
+
+auto SinglePassCompiler::ifStatement() -> void {
+
+    expression();
+
+    const int thenJump = emitJump(OpCode::JumpIfFalse);
+    emit(OpCode::Pop);
+
+    consume(TokenType::LeftBrace);
+    scopedBlock();
+
+    const int exitJump = emitJump(OpCode::Jump);
+
+    patchJump(thenJump);
+    emit(OpCode::Pop);
+
+    if(match(TokenType::ElseKeyword)){
+        consume(TokenType::LeftBrace);
+        scopedBlock();
+    }
+
+    patchJump(exitJump);
+}
+
+auto SinglePassCompiler::whileStatement() -> void {
+
+    // The Compiler opens a scope for the hoisted invariants.
+    beginScope();
+
+    Loop loop;
+    beginLoop(&loop);
+
+    expression();
+
+    const int exitJump = emitJump(OpCode::JumpIfFalse);
+    emit(OpCode::Pop);
+
+    consume(TokenType::LeftBrace);
+    scopedBlock();
+
+    emitLoop(loop.start);
+
+    patchJump(exitJump);
+    emit(OpCode::Pop);
+
+    endLoop();
+    endScope();
+}
+
+auto SinglePassCompiler::forStatement() -> void {
+
+    if(!consume(TokenType::Identifier)) return;
+    const std::string_view variable = previous().lexeme;
+
+    if(current_->localsCount + 4 > Compiler::MAX_LOCALS){
+        fail();
+        return;
+    }
+
+    beginScope();
+
+    const int control = current_->localsCount;
+
+    consume(TokenType::Assign);
+    expression();
+    addLocal("$for");
+    markVariableAsDefined();
+
+    consume(TokenType::Comma);
+    expression();
+    addLocal("$for");
+    markVariableAsDefined();
+
+    if(match(TokenType::Comma)){
+        const Constant step = expression();
+        if(step.has_value() && step->asNumber() == 0) fail();
+    } else {
+        emitConstant(Value(std::int64_t(1)));
+    }
+
+    addLocal("$for");
+    markVariableAsDefined();
+
+    emit(OpCode::ForPrep);
+    emit(static_cast<Byte>(control));
+    const int exitJump = codeSize();
+    emit(Byte(0xff));
+    emit(Byte(0xff));
+
+    addLocal(variable);
+    markVariableAsDefined();
+
+    Loop loop;
+    loop.counted = true;
+    beginLoop(&loop);
+
+    consume(TokenType::LeftBrace);
+    scopedBlock();
+
+    for(const int jump : loop.continues){
+        patchJump(jump);
+    }
+
+    emit(OpCode::ForLoop);
+    emit(static_cast<Byte>(control));
+
+    const int offset = codeSize() - loop.start + 2;
+    if(offset > UINT16_MAX) fail();
+
+    emit(static_cast<Byte>((offset >> 8) & 0xff));
+    emit(static_cast<Byte>(offset & 0xff));
+
+    patchJump(exitJump);
+
+    endLoop();
+    endScope();
+}
+
+auto SinglePassCompiler::matchStatement() -> void {
+
+    expression();
+
+    const std::size_t index = addCaseTable();
+    if(index > UINT8_MAX){
+        fail();
+        return;
+    }
+
+    emit(OpCode::JumpTable);
+    emit(static_cast<Byte>(index));
+
+    // The Compiler places the else arm right after the instruction, here
+    // it is only known at the end: a jump to it takes its place.
+    const std::size_t base = codeSize();
+    int elseJump = emitJump(OpCode::Jump);
+
+    CaseTable table;
+    std::vector<int> exits;
+
+    consume(TokenType::LeftBrace);
+
+    while(!check(TokenType::RightBrace) && !isAtEnd() && !failed_){
+        if(match(TokenType::ElseKeyword)){
+            consume(TokenType::LeftBrace);
+
+            patchJump(elseJump);
+            elseJump = -1;
+
+            scopedBlock();
+            break;
+        }
+
+        const auto target = static_cast<std::uint16_t>(codeSize() - base);
+
+        do{
+            matchLabel(table, target);
+        } while(match(TokenType::Comma) && !failed_);
+
+        consume(TokenType::LeftBrace);
+        scopedBlock();
+
+        exits.push_back(emitJump(OpCode::Jump));
+    }
+
+    consume(TokenType::RightBrace);
+
+    if(elseJump != -1) patchJump(elseJump);
+
+    for(const int exit : exits){
+        patchJump(exit);
+    }
+
+    if(codeSize() - base > UINT16_MAX){
+        fail();
+        return;
+    }
+
+    if(current_->skimmed) return;
+
+    packCaseTable(table);
+    currentChunk().getCaseTable(index) = std::move(table);
+}
+
+auto SinglePassCompiler::matchLabel(CaseTable& table, std::uint16_t target) -> void {
+
+    const bool negative = match(TokenType::Minus);
+
+    if(!negative && match(TokenType::StringLiteral)){
+        const std::string_view lexeme = previous().lexeme;
+
+        if(!table.strings.emplace(lexeme.substr(1, lexeme.size() - 2), target).second) fail();
+        return;
+    }
+
+    if(!match(TokenType::IntegerLiteral)){
+        fail();
+        return;
+    }
+
+    const std::string_view lexeme = previous().lexeme;
+    std::int64_t integer;
+
+    if(std::from_chars(lexeme.data(), lexeme.data() + lexeme.size(), integer).ec != std::errc()){
+        fail();
+        return;
+    }
+
+    if(!table.integers.emplace(negative ? -integer : integer, target).second) fail();
+}
+
+auto SinglePassCompiler::expressionStatement() -> void {
+    expression();
+    consume(TokenType::Semicolon);
+
+    emit(OpCode::Pop);
+}
+
+auto SinglePassCompiler::continueStatement() -> void {
+
+    consume(TokenType::Semicolon);
+
+    Loop* loop = current_->loop;
+
+    if(loop == nullptr){
+        fail();
+        return;
+    }
+
+    for(int i = current_->localsCount - 1; i >= 0 && current_->locals[i].depth > loop->scopeDepth; i--){
+        emit(OpCode::Pop);
+    }
+
+    if(loop->counted){
+        loop->continues.push_back(emitJump(OpCode::Jump));
+        return;
+    }
+
+    emitLoop(loop->start);
+}
+
+auto SinglePassCompiler::breakStatement() -> void {
+
+    consume(TokenType::Semicolon);
+
+    Loop* loop = current_->loop;
+
+    if(loop == nullptr){
+        fail();
+        return;
+    }
+
+    for(int i = current_->localsCount - 1; i >= 0 && current_->locals[i].depth > loop->scopeDepth; i--){
+        emit(OpCode::Pop);
+    }
+
+    loop->breaks.push_back(emitJump(OpCode::Jump));
+}
+
+auto SinglePassCompiler::returnStatement() -> void {
+
+    if(current_->type == FunctionType::Script){
+        fail();
+        return;
+    }
+
+    // The Parser expects the ';' after an empty return as well.
+    !match(TokenType::Semicolon)
+        ? static_cast<void>(expression())
+        : emit(OpCode::Nil);
+
+    consume(TokenType::Semicolon);
+    emit(OpCode::Return);
+}
+
+auto SinglePassCompiler::printStatement() -> void {
+    expression();
+    consume(TokenType::Semicolon);
+
+    emit(OpCode::Print);
+}
+
+auto SinglePassCompiler::parsePrecedence(Precedence prec) -> Constant {
+
+    // advance() stays on the last token at the end, see Parser.
+    if(isAtEnd()){
+        fail();
+        return std::nullopt;
+    }
+
+    advance();
+
+    ParsePrefix prefix = getParseRules(previous().type).prefix;
+
+    if(nullptr == prefix){
+        fail();
+        return std::nullopt;
+    }
+
+    // Only the left operand of the outermost `=` may be assigned, as the
+    // Parser only accepts a variable there.
+    Constant left = std::invoke(prefix, this, prec == Precedence::None);
+
+    while(prec < getParseRules(peek().type).prec){
+        advance();
+
+        ParseInfix infix = getParseRules(previous().type).infix;
+
+        if(infix == nullptr) break;
+        left = std::invoke(infix, this, left);
+    }
+
+    return left;
+}
+
+auto SinglePassCompiler::expression() -> Constant {
+    return parsePrecedence(Precedence::None);
+}
+
+auto SinglePassCompiler::assignmentExpression([[maybe_unused]] const Constant& left) -> Constant {
+    // Assignments to variables are compiled by variableExpression, any
+    // other target is an error.
+    fail();
+    return std::nullopt;
+}
+
+auto SinglePassCompiler::binaryExpression(const Constant& left) -> Constant {
+
+    const TokenType operatorType = previous().type;
+    const auto precedence = static_cast<Precedence>(getParseRules(operatorType).prec);
+
+    if(operatorType == TokenType::AndKeyword){
+        const int jump = emitJump(OpCode::JumpIfFalse);
+        emit(OpCode::Pop);
+
+        parsePrecedence(precedence);
+        patchJump(jump);
+
+        return std::nullopt;
+    }
+
+    if(operatorType == TokenType::OrKeyword){
+        const int elseJump = emitJump(OpCode::JumpIfFalse);
+        const int endJump = emitJump(OpCode::Jump);
+
+        patchJump(elseJump);
+        emit(OpCode::Pop);
+
+        parsePrecedence(precedence);
+        patchJump(endJump);
+
+        return std::nullopt;
+    }
+
+    const Constant right = parsePrecedence(precedence);
+
+    // Operands proven to be numbers skip the VM's type checks.
+    const bool numeric = left.has_value() && right.has_value();
+
+    switch(operatorType){
+        case TokenType::Minus:
+            emit(numeric ? OpCode::SubNum : OpCode::Sub);
+            return numeric ? Constant(subtractNumbers(left.value(), right.value())) : std::nullopt;
+        case TokenType::Plus:
+            emit(numeric ? OpCode::AddNum : OpCode::Add);
+            return numeric ? Constant(addNumbers(left.value(), right.value())) : std::nullopt;
+        case TokenType::Star:
+            emit(numeric ? OpCode::MultNum : OpCode::Mult);
+            return numeric ? Constant(multiplyNumbers(left.value(), right.value())) : std::nullopt;
+        case TokenType::Slash:
+            emit(numeric ? OpCode::DivNum : OpCode::Div);
+            return numeric ? Constant(divideNumbers(left.value(), right.value())) : std::nullopt;
+        case TokenType::Exponent:
+            emit(OpCode::Pow);
+            return numeric ? Constant(powerNumbers(left.value(), right.value())) : std::nullopt;
+        case TokenType::Less:
+            emit(numeric ? OpCode::LessNum : OpCode::Less);
+            break;
+        case TokenType::Greater:
+            emit(numeric ? OpCode::GreaterNum : OpCode::Greater);
+            break;
+        case TokenType::LessEqual:
+            emit(numeric ? OpCode::GreaterNum : OpCode::Greater);
+            emit(OpCode::Not);
+            break;
+        case TokenType::GreaterEqual:
+            emit(numeric ? OpCode::LessNum : OpCode::Less);
+            emit(OpCode::Not);
+            break;
+        case TokenType::Equal:
+            emit(OpCode::Equal);
+            break;
+        case TokenType::NotEqual:
+            emit(OpCode::Equal);
+            emit(OpCode::Not);
+            break;
+        default:
+            fail();
+            break;
+    }
+
+    return std::nullopt;
+}
+
+auto SinglePassCompiler::unaryExpression([[maybe_unused]] bool canAssign) -> Constant {
+
+    const TokenType operatorType = previous().type;
+    const Constant right = parsePrecedence(Precedence::Unary);
+
+    switch(operatorType){
+        case TokenType::Minus:
+            emit(OpCode::Negate);
+            return right.has_value() ? Constant(negateNumber(right.value())) : std::nullopt;
+        case TokenType::NotKeyword:
+            emit(OpCode::Not);
+            return std::nullopt;
+        case TokenType::Plus:
+            return right;
+        default:
+            fail();
+            return std::nullopt;
+    }
+}
+
+auto SinglePassCompiler::callExpression([[maybe_unused]] const Constant& left) -> Constant {
+
+    int count = 0;
+
+    if(!match(TokenType::RightParen)){
+        do{
+            expression();
+            count++;
+        } while(match(TokenType::Comma) && !failed_);
+
+        consume(TokenType::RightParen);
+    }
+
+    emit(OpCode::Call);
+    emit(static_cast<Byte>(count));
+
+    return std::nullopt;
+}
+
+auto SinglePassCompiler::groupingExpression([[maybe_unused]] bool canAssign) -> Constant {
+    const Constant inner = expression();
+    consume(TokenType::RightParen);
+
+    return inner;
+}
+
+auto SinglePassCompiler::literalExpression([[maybe_unused]] bool canAssign) -> Constant {
+
+    const Token& token = previous();
+
+    switch(token.type){
+        case TokenType::StringLiteral: {
+            emit(OpCode::PushConstant);
+            emit(makeConstant(token.lexeme.substr(1, token.lexeme.size() - 2)));
+            return std::nullopt;
+        }
+        case TokenType::NumberLiteral: {
+            const double number = std::strtod(token.lexeme.data(), nullptr);
+            emitConstant(number);
+            return Value(number);
+        }
+        case TokenType::IntegerLiteral: {
+            std::int64_t integer;
+            const char* end = token.lexeme.data() + token.lexeme.size();
+
+            // Too large for 64 bits, keep the closest double instead.
+            if(std::from_chars(token.lexeme.data(), end, integer).ec != std::errc()){
+                const double number = std::strtod(token.lexeme.data(), nullptr);
+                emitConstant(number);
+                return Value(number);
+            }
+
+            emitConstant(integer);
+            return Value(integer);
+        }
+        case TokenType::TrueKeyword:
+            emit(OpCode::True);
+            return std::nullopt;
+        case TokenType::FalseKeyword:
+            emit(OpCode::False);
+            return std::nullopt;
+        case TokenType::NilKeyword:
+            emit(OpCode::Nil);
+            return std::nullopt;
+        default:
+            fail();
+            return std::nullopt;
+    }
+}
+
+auto SinglePassCompiler::variableExpression(bool canAssign) -> Constant {
+
+    const std::string_view name = previous().lexeme;
+
+    if(canAssign && match(TokenType::Assign)){
+        parsePrecedence(static_cast<Precedence>(Precedence::Assignment - 1));
+
+        int index = resolveVariableName(name);
+
+        if(index == -1){
+            index = makeConstant(name);
+            emit(OpCode::SetGlobal);
+        } else {
+            emit(OpCode::SetLocal);
+        }
+
+        emit(static_cast<Byte>(index));
+        return std::nullopt;
+    }
+
+    int index = resolveVariableName(name);
+
+    if(index == -1){
+        index = makeConstant(name);
+        emit(OpCode::GetGlobal);
+    } else {
+        emit(OpCode::GetLocal);
+    }
+
+    emit(static_cast<Byte>(index));
+    return std::nullopt;
+}
+
+auto SinglePassCompiler::makeConstant(Value value) -> Byte {
+    return current_->skimmed ? 0 : currentChunk().addConstant(std::move(value));
+}
+
+auto SinglePassCompiler::makeConstant(std::string_view string) -> Byte {
+    return current_->skimmed ? 0 : currentChunk().addConstant(std::string(string));
+}
+
+auto SinglePassCompiler::addCaseTable() -> std::size_t {
+    return current_->skimmed
+        ? current_->caseTables++
+        : currentChunk().addCaseTable(CaseTable());
+}
+
+auto SinglePassCompiler::emitConstant(Value value) -> void {
+    emit(OpCode::PushConstant);
+    emit(makeConstant(std::move(value)));
+}
+
+auto SinglePassCompiler::emitJump(OpCode instruction) -> int {
+    emit(instruction);
+
+    emit(Byte(0xff));
+    emit(Byte(0xff));
+
+    return codeSize() - 2;
+}
+
+auto SinglePassCompiler::emitLoop(std::uint32_t start) -> void {
+
+    emit(OpCode::Loop);
+    const int offset = codeSize() - start + 2;
+
+    if(offset > UINT16_MAX){
+        fail();
+        return;
+    }
+
+    emit(static_cast<Byte>((offset >> 8) & 0xff));
+    emit(static_cast<Byte>(offset & 0xff));
+}
+
+auto SinglePassCompiler::patchJump(int offset) -> void {
+
+    const int jump = codeSize() - offset - 2;
+
+    if(jump > SHORT_MAX){
+        fail();
+        return;
+    }
+
+    if(current_->skimmed) return;
+
+    currentChunk()[offset] = (jump >> 8) & 0xff;
+    currentChunk()[offset+1] = jump & 0xff;
+}
+
+auto SinglePassCompiler::endScope() -> void {
+    current_->scopeDepth--;
+
+    while(current_->localsCount > 0 &&
+          current_->locals[current_->localsCount - 1].depth > current_->scopeDepth){
+        emit(OpCode::Pop);
+        current_->localsCount--;
+    }
+}
+
+auto SinglePassCompiler::beginLoop(Loop* loop) -> void {
+
+    loop->enclosing = current_->loop;
+    loop->scopeDepth = current_->scopeDepth;
+    loop->start = codeSize();
+
+    current_->loop = loop;
+}
+
+auto SinglePassCompiler::endLoop() -> void {
+
+    // `break` leaves the loop after everything it pushed has been popped.
+    for(const int jump : current_->loop->breaks){
+        patchJump(jump);
+    }
+
+    current_->loop = current_->loop->enclosing;
+}
+
+auto SinglePassCompiler::addLocal(std::string_view name) -> void {
+    current_->locals[current_->localsCount++] = Local { name, -1 };
+}
+
+auto SinglePassCompiler::declareVariable(std::string_view name) -> void {
+
+    if(current_->scopeDepth == 0) return;
+
+    if(current_->localsCount >= Compiler::MAX_LOCALS){
+        fail();
+        return;
+    }
+
+    for(int i = current_->localsCount - 1; i >= 0; i--){
+        const Local& local = current_->locals[i];
+        if(local.depth != -1 && local.depth < current_->scopeDepth) break;
+
+        if(name == local.name){
+            fail();
+            return;
+        }
+    }
+
+    addLocal(name);
+}
+
+auto SinglePassCompiler::defineVariable(std::string_view name) -> void {
+
+    if(current_->scopeDepth > 0){
+        markVariableAsDefined();
+        return;
+    }
+
+    const Byte index = makeConstant(name);
+    emit(OpCode::DefineGlobal);
+    emit(index);
+}
+
+auto SinglePassCompiler::markVariableAsDefined() -> void {
+    current_->locals[current_->localsCount - 1].depth = current_->scopeDepth;
+}
+
+auto SinglePassCompiler::resolveVariableName(std::string_view name) -> int {
+
+    for(int i = current_->localsCount - 1; i >= 0; i--){
+        if(name != current_->locals[i].name) continue;
+
+        // Used in its own initializer.
+        if(current_->locals[i].depth == -1) fail();
+        return i;
+    }
+
+    return -1;
+}
+
+auto SinglePassCompiler::advance() -> void {
+    if(isAtEnd()) return;
+    prev_ = curr_;
+    curr_ = lex_.next();
+}
+
+auto SinglePassCompiler::check(TokenType type) const -> bool {
+    return peek().type == type;
+}
+
+auto SinglePassCompiler::match(TokenType type) -> bool {
+    return check(type)
+        ? (advance(), true)
+        : false;
+}
+
+auto SinglePassCompiler::consume(TokenType type) -> bool {
+
+    if(match(type)) return true;
+
+    fail();
+    return false;
+}
+
+}
@@ -0,0 +1,61 @@
+#include "../include/source_manager.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace scriptlang::lexer {
+
+auto SourceManager::add(std::string text) -> SourceBuffer {
+
+    const std::uint32_t start = next_;
+
+    // One past the end is the position of the Eof token, so it still
+    // belongs to this buffer.
+    next_ += text.size() + 1;
+
+    const Buffer& buffer = buffers_.emplace_back(Buffer { std::move(text), start, {} });
+    return SourceBuffer { buffer.text, start };
+}
+
+auto SourceManager::findBuffer(SourcePosition position) const -> const Buffer& {
+
+    const auto it = std::upper_bound(buffers_.begin(), buffers_.end(), position.offset,
+        [](std::uint32_t offset, const Buffer& buffer){
+            return offset < buffer.start;
+        });
+
+    return *std::prev(it);
+}
+
+auto SourceManager::decode(SourcePosition position) const -> DecodedPosition {
+
+    const Buffer& buffer = findBuffer(position);
+    const std::uint32_t offset = position.offset - buffer.start;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& lineStarts = buffer.lineStarts;
+
+    if(lineStarts.empty()){
+        const char* begin = buffer.text.data();
+        const char* end = begin + buffer.text.size();
+
+        lineStarts.push_back(0);
+
+        for(const char* it = begin;
+            (it = static_cast<const char*>(std::memchr(it, '\n', end - it))) != nullptr;
+            it++){
+            lineStarts.push_back(it - begin + 1);
+        }
+    }
+
+    const auto line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+
+    return DecodedPosition {
+        buffer.text,
+        offset,
+        static_cast<std::uint32_t>(std::distance(lineStarts.begin(), line)),
+        offset - *std::prev(line) + 1
+    };
+}
+
+}
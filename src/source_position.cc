@@ -4,10 +4,7 @@ namespace scriptlang::lexer {
 
 
 auto operator<<(std::ostream& stream, SourcePosition position) -> std::ostream& {
-    return stream << "(Offset: " << position.offset << ")"
-           << "[Ln: " << position.line 
-           << ", Col: " << position.column 
-           << ']';
+    return stream << "(Offset: " << position.offset << ")";
 }
 
 auto operator<<(std::ostream& stream, SourceRange range) -> std::ostream& {
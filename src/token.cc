@@ -7,6 +7,11 @@ static constexpr const char* tokenNamesTable[] = {
     "DefunKeyword",
     "IfKeyword",
     "ElseKeyword",
+    "WhileKeyword",
+    "ForKeyword",
+    "MatchKeyword",
+    "ContinueKeyword",
+    "BreakKeyword",
     "ReturnKeyword",
     "PrintKeyword",
     "OrKeyword",
@@ -30,13 +35,16 @@ static constexpr const char* tokenNamesTable[] = {
     "Dot",
     "Comma",
     "Semicolon",
+    "Colon",
     "LeftParen",
     "RightParen",
     "LeftBrace",
     "RightBrace",
+    "At",
     "Identifier",
     "StringLiteral",
     "NumberLiteral",
+    "IntegerLiteral",
     "Eof"
 };
 
@@ -0,0 +1,644 @@
+#include "../include/type_inference.h"
+#include "../include/utils.h"
+
+namespace scriptlang::analysis {
+
+using scriptlang::utils::instanceof;
+
+namespace {
+
+// Collects every name read other than as the callee of a direct call,
+// a function read that way may be called from anywhere.
+class EscapeScanner final : private AstVisitor<EscapeScanner> {
+    friend class AstVisitor<EscapeScanner>;
+
+public:
+    explicit EscapeScanner(std::unordered_set<std::string_view>& escaped)
+        : escaped_(escaped) {}
+
+    auto scan(const StatementList& program) -> void {
+        for(const auto& stmt : program){
+            if(stmt != nullptr) stmt->accept(*this);
+        }
+    }
+
+private:
+    auto visitVariableDeclaration(const VariableDeclaration& decl) -> void {
+        decl.initializer()->accept(*this);
+    }
+
+    auto visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
+        decl.body()->accept(*this);
+    }
+
+    auto visitBlock(const Block& block) -> void {
+        scan(block.statements());
+    }
+
+    auto visitWhileStatement(const WhileStatement& stmt) -> void {
+        stmt.condition()->accept(*this);
+        stmt.body()->accept(*this);
+    }
+
+    auto visitForStatement(const ForStatement& stmt) -> void {
+        stmt.start()->accept(*this);
+        stmt.limit()->accept(*this);
+        if(stmt.haveStep()) stmt.step()->accept(*this);
+
+        stmt.body()->accept(*this);
+    }
+
+    auto visitIfStatement(const IfStatement& stmt) -> void {
+        stmt.condition()->accept(*this);
+        stmt.thenBranch()->accept(*this);
+
+        if(stmt.haveElseBranch()){
+            stmt.elseBranch()->accept(*this);
+        }
+    }
+
+    auto visitMatchStatement(const MatchStatement& stmt) -> void {
+        stmt.subject()->accept(*this);
+
+        for(const auto& arm : stmt.arms()){
+            arm.body->accept(*this);
+        }
+
+        if(stmt.haveElseBranch()){
+            stmt.elseBranch()->accept(*this);
+        }
+    }
+
+    auto visitExpressionStatement(const ExpressionStatement& stmt) -> void {
+        stmt.expression()->accept(*this);
+    }
+
+    auto visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {}
+    auto visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {}
+
+    auto visitReturnStatement(const ReturnStatement& stmt) -> void {
+        if(stmt.haveExpression()) stmt.expression()->accept(*this);
+    }
+
+    auto visitPrintStatement(const PrintStatement& stmt) -> void {
+        stmt.expression()->accept(*this);
+    }
+
+    auto visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+        expr.value()->accept(*this);
+    }
+
+    auto visitBinaryExpression(const BinaryExpression& expr) -> void {
+        expr.left()->accept(*this);
+        expr.right()->accept(*this);
+    }
+
+    auto visitUnaryExpression(const UnaryExpression& expr) -> void {
+        expr.right()->accept(*this);
+    }
+
+    auto visitCallExpression(const CallExpression& expr) -> void {
+        if(!instanceof<Expression, VariableExpression>(expr.callee().get())){
+            expr.callee()->accept(*this);
+        }
+
+        for(const auto& arg : expr.arguments()){
+            arg->accept(*this);
+        }
+    }
+
+    auto visitGroupingExpression(const GroupingExpression& expr) -> void {
+        expr.expression()->accept(*this);
+    }
+
+    auto visitVariableExpression(const VariableExpression& expr) -> void {
+        escaped_.insert(expr.name().lexeme);
+    }
+
+    auto visitLiteralExpression([[maybe_unused]] const LiteralExpression& expr) -> void {}
+
+private:
+    std::unordered_set<std::string_view>& escaped_;
+};
+
+auto isNumericLiteral(const Expression* expr) -> bool {
+
+    Expression* node = const_cast<Expression*>(expr);
+
+    if(instanceof<Expression, LiteralExpression>(node)){
+        return static_cast<LiteralExpression*>(node)->isNumber();
+    }
+
+    if(instanceof<Expression, GroupingExpression>(node)){
+        return isNumericLiteral(static_cast<GroupingExpression*>(node)->expression().get());
+    }
+
+    if(instanceof<Expression, UnaryExpression>(node)){
+        const auto unary = static_cast<UnaryExpression*>(node);
+
+        return unary->op().type != TokenType::NotKeyword &&
+               isNumericLiteral(unary->right().get());
+    }
+
+    return false;
+}
+
+}
+
+TypeInference::TypeInference(const StatementList& program, const ProgramAnalysis* analysis)
+    : analysis_(analysis) {
+
+    if(analysis_ != nullptr){
+        EscapeScanner scanner(escaped_);
+        scanner.scan(program);
+
+        for(const auto& stmt : program){
+            if(stmt == nullptr || !instanceof<Statement, FunctionDeclaration>(stmt.get())) continue;
+
+            const auto decl = static_cast<FunctionDeclaration*>(stmt.get());
+            const auto name = decl->name().lexeme;
+            const GlobalInfo* info = analysis_->global(name);
+
+            if(info->declarations == 1 && !info->assigned && escaped_.count(name) == 0){
+                params_[name] = std::vector<bool>(decl->params().size(), true);
+            }
+        }
+    }
+
+    // Parameters start out as numbers and are demoted until every call
+    // site agrees with the assumption.
+    while(true){
+        numbers_.clear();
+        locals_.clear();
+
+        for(const auto& [name, assumed] : params_){
+            arguments_[name] = std::vector<bool>(assumed.size(), true);
+        }
+
+        for(std::size_t i = 0; i < program.size(); i++){
+            if(program[i] == nullptr) continue;
+
+            topLevelIndex_ = static_cast<int>(i);
+            reachable_ = true;
+
+            analyzeStatement(program[i]);
+        }
+
+        bool changed = false;
+
+        for(auto& [name, assumed] : params_){
+            const auto& observed = arguments_.at(name);
+
+            for(std::size_t i = 0; i < assumed.size(); i++){
+                if(assumed[i] && !observed[i]){
+                    assumed[i] = false;
+                    changed = true;
+                }
+            }
+        }
+
+        if(!changed) break;
+    }
+}
+
+auto TypeInference::analyzeFunction(const FunctionDeclaration& decl) -> void {
+
+    Environment locals = std::move(locals_);
+    std::vector<std::size_t> scopes = std::move(scopes_);
+    LoopContext* loop = loop_;
+    const bool reachable = reachable_;
+
+    locals_.clear();
+    scopes_ = { 0 };
+    loop_ = nullptr;
+    reachable_ = true;
+
+    const auto assumed = params_.find(decl.name().lexeme);
+
+    for(std::size_t i = 0; i < decl.params().size(); i++){
+        const bool annotated = decl.annotations()[i] == TypeAnnotation::Number;
+        const bool number = annotated || (assumed != params_.end() && assumed->second[i]);
+
+        locals_.push_back({ decl.params()[i].lexeme, number, annotated });
+    }
+
+    if(instanceof<Statement, Block>(decl.body().get())){
+        for(const auto& stmt : static_cast<Block*>(decl.body().get())->statements()){
+            analyzeStatement(stmt);
+        }
+    }
+
+    locals_ = std::move(locals);
+    scopes_ = std::move(scopes);
+    loop_ = loop;
+    reachable_ = reachable;
+}
+
+auto TypeInference::analyzeStatement(const StatementPtr& stmt) -> void {
+    if(stmt != nullptr) stmt->accept(*this);
+}
+
+auto TypeInference::infer(const ExpressionPtr& expr) -> bool {
+
+    expr->accept(*this);
+
+    if(result_){
+        numbers_.insert(expr.get());
+    } else {
+        numbers_.erase(expr.get());
+    }
+
+    return result_;
+}
+
+auto TypeInference::isConstantNumber(std::string_view name) const -> bool {
+
+    if(analysis_ == nullptr) return false;
+
+    const GlobalInfo* info = analysis_->global(name);
+
+    return info != nullptr &&
+           info->declarations == 1 &&
+           !info->assigned &&
+           info->declaredAt < topLevelIndex_ &&
+           info->initializer != nullptr &&
+           isNumericLiteral(info->initializer);
+}
+
+auto TypeInference::isAnnotatedNumber(std::string_view name) const -> bool {
+
+    if(analysis_ == nullptr) return false;
+
+    const GlobalInfo* info = analysis_->global(name);
+    return info != nullptr && info->annotation == TypeAnnotation::Number;
+}
+
+auto TypeInference::isPromotable(std::string_view name) const -> bool {
+
+    if(analysis_ == nullptr) return false;
+
+    const GlobalInfo* info = analysis_->global(name);
+    return info != nullptr && info->promotable;
+}
+
+auto TypeInference::findLocal(std::string_view name) -> Local* {
+
+    for(auto local = locals_.rbegin(); local != locals_.rend(); local++){
+        if(local->name == name) return &*local;
+    }
+
+    return nullptr;
+}
+
+auto TypeInference::join(Environment& into, const Environment& from) const -> void {
+
+    const std::size_t size = std::min(into.size(), from.size());
+
+    for(std::size_t i = 0; i < size; i++){
+        into[i].number = into[i].number && from[i].number;
+    }
+}
+
+auto TypeInference::visitVariableDeclaration(const VariableDeclaration& decl) -> void {
+
+    const bool annotated = decl.annotation() == TypeAnnotation::Number;
+    const bool number = infer(decl.initializer()) || annotated;
+
+    // Globals no function touches are tracked like locals of the script.
+    if(!scopes_.empty() || isPromotable(decl.name().lexeme)){
+        locals_.push_back({ decl.name().lexeme, number, annotated });
+    }
+}
+
+auto TypeInference::visitFunctionDeclaration(const FunctionDeclaration& decl) -> void {
+
+    analyzeFunction(decl);
+
+    if(!scopes_.empty()){
+        locals_.push_back({ decl.name().lexeme, false });
+    }
+}
+
+auto TypeInference::visitBlock(const Block& block) -> void {
+
+    scopes_.push_back(locals_.size());
+
+    for(const auto& stmt : block.statements()){
+        analyzeStatement(stmt);
+    }
+
+    locals_.resize(scopes_.back());
+    scopes_.pop_back();
+}
+
+auto TypeInference::visitWhileStatement(const WhileStatement& stmt) -> void {
+
+    const Environment entry = locals_;
+    const bool reachable = reachable_;
+
+    // Iterate to a fixed point of the loop header; types only ever go from
+    // number to unknown, so this terminates.
+    Environment header = entry;
+    LoopContext loop { loop_, entry.size(), {}, {} };
+
+    while(true){
+        loop.breaks.clear();
+        loop.continues.clear();
+
+        locals_ = header;
+        reachable_ = reachable;
+
+        infer(stmt.condition());
+        const Environment exit = locals_;
+
+        loop_ = &loop;
+        analyzeStatement(stmt.body());
+        loop_ = loop.enclosing;
+
+        Environment next = entry;
+
+        if(reachable_) join(next, locals_);
+        for(const auto& env : loop.continues) join(next, env);
+
+        bool stable = true;
+        for(std::size_t i = 0; i < next.size(); i++){
+            stable = stable && next[i].number == header[i].number;
+        }
+
+        if(stable){
+            locals_ = exit;
+            for(const auto& env : loop.breaks) join(locals_, env);
+
+            reachable_ = reachable;
+            return;
+        }
+
+        header = std::move(next);
+    }
+}
+
+auto TypeInference::visitForStatement(const ForStatement& stmt) -> void {
+
+    infer(stmt.start());
+    infer(stmt.limit());
+    if(stmt.haveStep()) infer(stmt.step());
+
+    const Environment entry = locals_;
+    const bool reachable = reachable_;
+
+    // Same fixed point as `while`. The loop variable is reset from the
+    // hidden counter, which only ever holds numbers, on every iteration.
+    Environment header = entry;
+    LoopContext loop { loop_, entry.size(), {}, {} };
+
+    while(true){
+        loop.breaks.clear();
+        loop.continues.clear();
+
+        locals_ = header;
+        reachable_ = reachable;
+
+        locals_.push_back({ stmt.variable().lexeme, true });
+
+        loop_ = &loop;
+        analyzeStatement(stmt.body());
+        loop_ = loop.enclosing;
+
+        locals_.resize(entry.size());
+
+        Environment next = entry;
+
+        if(reachable_) join(next, locals_);
+        for(const auto& env : loop.continues) join(next, env);
+
+        bool stable = true;
+        for(std::size_t i = 0; i < next.size(); i++){
+            stable = stable && next[i].number == header[i].number;
+        }
+
+        if(stable){
+            locals_ = std::move(header);
+            for(const auto& env : loop.breaks) join(locals_, env);
+
+            reachable_ = reachable;
+            return;
+        }
+
+        header = std::move(next);
+    }
+}
+
+auto TypeInference::visitIfStatement(const IfStatement& stmt) -> void {
+
+    infer(stmt.condition());
+
+    const Environment before = locals_;
+    const bool reachable = reachable_;
+
+    analyzeStatement(stmt.thenBranch());
+
+    const Environment then = std::move(locals_);
+    const bool thenReachable = reachable_;
+
+    locals_ = before;
+    reachable_ = reachable;
+
+    if(stmt.haveElseBranch()){
+        analyzeStatement(stmt.elseBranch());
+    }
+
+    if(thenReachable && reachable_){
+        join(locals_, then);
+    } else if(thenReachable){
+        locals_ = then;
+        reachable_ = true;
+    }
+}
+
+auto TypeInference::visitMatchStatement(const MatchStatement& stmt) -> void {
+
+    infer(stmt.subject());
+
+    const Environment before = locals_;
+    const bool reachable = reachable_;
+
+    // Without an else arm the subject may match no arm at all.
+    Environment after = before;
+    bool afterReachable = reachable && !stmt.haveElseBranch();
+
+    const auto analyzeArm = [&](const StatementPtr& body) {
+        locals_ = before;
+        reachable_ = reachable;
+
+        analyzeStatement(body);
+
+        if(!reachable_) return;
+
+        if(afterReachable){
+            join(after, locals_);
+        } else {
+            after = locals_;
+            afterReachable = true;
+        }
+    };
+
+    for(const auto& arm : stmt.arms()){
+        analyzeArm(arm.body);
+    }
+
+    if(stmt.haveElseBranch()){
+        analyzeArm(stmt.elseBranch());
+    }
+
+    locals_ = std::move(after);
+    reachable_ = afterReachable;
+}
+
+auto TypeInference::visitExpressionStatement(const ExpressionStatement& stmt) -> void {
+    infer(stmt.expression());
+}
+
+auto TypeInference::visitContinueStatement([[maybe_unused]] const ContinueStatement& stmt) -> void {
+
+    if(loop_ != nullptr){
+        loop_->continues.emplace_back(locals_.begin(), locals_.begin() + loop_->locals);
+    }
+
+    reachable_ = false;
+}
+
+auto TypeInference::visitBreakStatement([[maybe_unused]] const BreakStatement& stmt) -> void {
+
+    if(loop_ != nullptr){
+        loop_->breaks.emplace_back(locals_.begin(), locals_.begin() + loop_->locals);
+    }
+
+    reachable_ = false;
+}
+
+auto TypeInference::visitReturnStatement(const ReturnStatement& stmt) -> void {
+
+    if(stmt.haveExpression()){
+        infer(stmt.expression());
+    }
+
+    reachable_ = false;
+}
+
+auto TypeInference::visitPrintStatement(const PrintStatement& stmt) -> void {
+    infer(stmt.expression());
+}
+
+auto TypeInference::visitAssignmentExpression(const AssignmentExpression& expr) -> void {
+
+    bool number = infer(expr.value());
+
+    Local* local = findLocal(expr.name().lexeme);
+
+    if(local != nullptr){
+        number = number || local->annotated;
+        local->number = number;
+    } else {
+        number = number || isAnnotatedNumber(expr.name().lexeme);
+    }
+
+    result_ = number;
+}
+
+auto TypeInference::visitBinaryExpression(const BinaryExpression& expr) -> void {
+
+    const TokenType operatorType = expr.op().type;
+
+    if(operatorType == TokenType::AndKeyword || operatorType == TokenType::OrKeyword){
+        const bool left = infer(expr.left());
+
+        // The right operand only runs on one path.
+        const Environment skipped = locals_;
+        const bool right = infer(expr.right());
+
+        join(locals_, skipped);
+
+        // Zero is falsey, so either operand can be the result.
+        result_ = left && right;
+        return;
+    }
+
+    const bool left = infer(expr.left());
+    const bool right = infer(expr.right());
+
+    switch(operatorType){
+        case TokenType::Minus:
+        case TokenType::Star:
+        case TokenType::Slash:
+        case TokenType::Exponent:
+            result_ = true;
+            break;
+        case TokenType::Plus:
+            // number + string fails, so one number operand is enough.
+            result_ = left || right;
+            break;
+        default:
+            result_ = false;
+            break;
+    }
+}
+
+auto TypeInference::visitUnaryExpression(const UnaryExpression& expr) -> void {
+
+    const bool right = infer(expr.right());
+
+    switch(expr.op().type){
+        case TokenType::Minus:
+            result_ = true;
+            break;
+        case TokenType::Plus:
+            result_ = right;
+            break;
+        default:
+            result_ = false;
+            break;
+    }
+}
+
+auto TypeInference::visitCallExpression(const CallExpression& expr) -> void {
+
+    infer(expr.callee());
+
+    std::vector<bool>* observed = nullptr;
+
+    if(instanceof<Expression, VariableExpression>(expr.callee().get())){
+        const auto name = static_cast<VariableExpression*>(expr.callee().get())->name().lexeme;
+        const auto arguments = arguments_.find(name);
+
+        if(findLocal(name) == nullptr && arguments != arguments_.end() &&
+           arguments->second.size() == expr.arguments().size()){
+            observed = &arguments->second;
+        }
+    }
+
+    for(std::size_t i = 0; i < expr.arguments().size(); i++){
+        const bool number = infer(expr.arguments()[i]);
+        if(observed != nullptr && !number) (*observed)[i] = false;
+    }
+
+    result_ = false;
+}
+
+auto TypeInference::visitGroupingExpression(const GroupingExpression& expr) -> void {
+    result_ = infer(expr.expression());
+}
+
+auto TypeInference::visitVariableExpression(const VariableExpression& expr) -> void {
+
+    const Local* local = findLocal(expr.name().lexeme);
+
+    result_ = local != nullptr
+        ? local->number
+        : isConstantNumber(expr.name().lexeme) || isAnnotatedNumber(expr.name().lexeme);
+}
+
+auto TypeInference::visitLiteralExpression(const LiteralExpression& expr) -> void {
+    result_ = expr.isNumber();
+}
+
+}
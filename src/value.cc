@@ -1,5 +1,7 @@
 #include "../include/value.h"
 
+#include <charconv>
+
 namespace scriptlang::runtime {
 
 struct OutputVisitor final {
@@ -18,6 +20,13 @@ struct OutputVisitor final {
         stream_ << value;
     }
 
+    auto operator()(std::int64_t value) -> void {
+        char buffer[24];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+
+        stream_.write(buffer, result.ptr - buffer);
+    }
+
     auto operator()(const std::string& value) -> void {
         stream_ << value;
     }
@@ -52,6 +61,10 @@ struct FalsinessVisitor final {
     constexpr auto operator()(const double number) const -> bool{ 
         return number == 0; 
     }
+
+    constexpr auto operator()(const std::int64_t number) const -> bool{ 
+        return number == 0; 
+    }
     
     template <typename T>
     constexpr auto operator()([[maybe_unused]] const T& value) const -> bool { 
@@ -10,24 +10,103 @@ namespace scriptlang::runtime {
 using scriptlang::disassembler::Disassembler;
 using scriptlang::utils::format;
 
+// Error message when the value does not have the annotated type.
+static auto typeError(const Value& value, Byte type) -> const char* {
+
+    switch(static_cast<CheckedType>(type)){
+        case CheckedType::Number:
+            return value.isNumber() ? nullptr : "Expect a number.";
+        case CheckedType::String:
+            return value.isString() ? nullptr : "Expect a string.";
+        case CheckedType::Boolean:
+            return value.isBoolean() ? nullptr : "Expect a boolean.";
+    }
+
+    return nullptr;
+}
+
+// Whether a numeric `for` loop runs another iteration with `counter`.
+static auto forContinues(const Value& counter, const Value& limit, const Value& step) -> bool {
+    return step.asNumber() > 0
+        ? !greaterNumbers(counter, limit)
+        : !lessNumbers(counter, limit);
+}
+
+// Offset of the arm of a `match` for `value`, 0 when no arm matches.
+static auto jumpTableOffset(const CaseTable& table, const Value& value) -> std::uint16_t {
+
+    if(value.isString()){
+        const auto it = table.strings.find(value.asString());
+        return it != table.strings.end() ? it->second : 0;
+    }
+
+    if(!value.isNumber()) return 0;
+
+    // A double matches the integer case it is equal to.
+    std::int64_t key;
+    if(value.isInteger()){
+        key = value.asInteger();
+    } else {
+        const double number = value.asNumber();
+        if(!(number >= -0x1p63 && number < 0x1p63)) return 0;
+
+        key = static_cast<std::int64_t>(number);
+        if(static_cast<double>(key) != number) return 0;
+    }
+
+    const std::uint64_t index = static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(table.low);
+    if(index < table.dense.size()) return table.dense[index];
+
+    const auto it = table.integers.find(key);
+    return it != table.integers.end() ? it->second : 0;
+}
+
 template<typename... Args>
 auto VM::runtimeError(const char* message, Args&&... args) -> void {
 
+    if(quiet_){
+        resetStack();
+        return;
+    }
+
     const CallFrame* frame = currentFrame();
 
-    const std::uint32_t line = frame->function->chunk.getLine(frame->ip - 1);
-    std::cout << "Runtime error [Ln: " << line << "] " 
-              << format(message, std::forward<Args>(args)...)
-              << '\n';
+    std::cout << "Runtime error ";
+
+    if(sources_ != nullptr){
+        const std::uint32_t position = frame->chunk->getPosition(frame->ip - 1);
+        std::cout << "[Ln: " << sources_->decode({ position }).line << "] ";
+    }
+
+    std::cout << format(message, std::forward<Args>(args)...) << '\n';
 
     for(int i = frameCount_ - 1; i >= 0; i--){
         const auto function = frames_[i].function;
+        const std::uint32_t offset = frames_[i].ip - 1;
+
+        // Calls the compiler inlined are frames of their own in the source.
+        for(const InlinedCall& call : frames_[i].chunk->inlinedCalls()){
+            if(call.start <= offset && offset < call.end){
+                std::cout << "    in <function '" << call.name << "' (param count: " << call.arity << ") >\n";
+            }
+        }
+
         std::cout << "    in "  << *function << "\n";
     }
 
     resetStack();
 }
 
+auto VM::recordBranch(const CallFrame& frame) -> void {
+
+    // The jump instruction is 3 bytes long, its operand was just read.
+    const BranchSite* site = frame.chunk->getBranchSite(frame.ip - 3);
+
+    if(site != nullptr){
+        profile_->recordBranch(site->line, site->column, !peek().isFalsey());
+    }
+}
+
 auto VM::call(ObjectFunction* function, int argc) -> bool {
     
     if(frameCount_ == CALL_FRAMES){
@@ -40,11 +119,41 @@ auto VM::call(ObjectFunction* function, int argc) -> bool {
         return false;
     }
 
+    const Chunk* chunk = function->lazy != nullptr ? compileBody(*function) : &function->chunk;
+
+    if(chunk == nullptr){
+        return false;
+    }
+
+    if(profile_ != nullptr && !function->name.empty()){
+        profile_->recordCall(function->name);
+    }
+
+    const Value* args = stackTop_ - argc;
+    bool memoized = false;
+
+    if(function->memo != nullptr && MemoCache::isKey(args, argc)){
+        // A hit replaces the callee and its arguments with the result, no
+        // frame is needed.
+        if(const Value* result = function->memo->find(args, argc)){
+            Value value = *result;
+
+            stackTop_ -= argc + 1;
+            push(std::move(value));
+            return true;
+        }
+
+        memoKeys_.emplace_back(args, args + argc);
+        memoized = true;
+    }
+
     CallFrame& frame = frames_[frameCount_++];
 
     frame.function = function;
+    frame.chunk = chunk;
     frame.ip = 0;
     frame.slots = stackTop_ - argc - 1;
+    frame.memoized = memoized;
 
     return true;
 }
@@ -58,14 +167,70 @@ auto VM::callValue(Value& value, int argc) -> bool {
     return call(&value.asFunction(), argc);
 }
 
+auto VM::compileBody(ObjectFunction& function) -> const Chunk* {
+
+    LazyBody& body = *function.lazy;
+
+    if(body.chunk == nullptr){
+        std::optional<Chunk> chunk = body.compile();
+
+        if(!chunk.has_value()){
+            runtimeError("Could not compile function '%s'.", function.name.c_str());
+            return nullptr;
+        }
+
+        body.chunk = std::make_shared<const Chunk>(std::move(chunk.value()));
+    }
+
+    return body.chunk.get();
+}
+
 auto VM::execute(ObjectFunction* function) -> InterpreterResult {
    
     push(*function);
     call(function, 0);
 
-    return run();
+    return profile_ != nullptr ? run<RunMode::Profiled>() : run<RunMode::Normal>();
+}
+
+auto VM::defineGlobal(const std::string& name, Value value) -> void {
+    globals_[name] = std::move(value);
+}
+
+auto VM::evaluate(const std::string& name, const std::vector<Value>& args,
+                  std::uint64_t& fuel) -> std::optional<Value> {
+
+    const auto global = globals_.find(name);
+    if(global == globals_.end()) return std::nullopt;
+
+    resetStack();
+    push(global->second);
+
+    for(const auto& arg : args){
+        push(arg);
+    }
+
+    quiet_ = true;
+    fuel_ = fuel;
+
+    const int argc = static_cast<int>(args.size());
+    bool success = callValue(peek(argc), argc);
+
+    // A memoized result replaces the call without pushing a frame.
+    if(success && frameCount_ > 0){
+        success = run<RunMode::Metered>() == InterpreterResult::Success;
+    }
+
+    quiet_ = false;
+    fuel = fuel_;
+    resetStack();
+
+    if(!success) return std::nullopt;
+
+    return stack_[0];
 }
 
+template<VM::RunMode Mode>
 auto VM::run() -> InterpreterResult {
 
 #ifdef DEBUG
@@ -74,13 +239,13 @@ auto VM::run() -> InterpreterResult {
 
     CallFrame* frame = currentFrame();
 
-    #define READ_CONSTANT() (frame->function->chunk.getConstant(readByte()))
+    #define READ_CONSTANT() (frame->chunk->getConstant(readByte()))
     #define READ_SHORT() (static_cast<std::uint16_t>(((readByte() << 8) | readByte())))
     #define RUNTIME_ERROR(...) \
         runtimeError(__VA_ARGS__); \
         return InterpreterResult::RuntimeError
 
-    #define BINARY_OPERATION(op) do {                   \
+    #define BINARY_OPERATION(operation) do {            \
             auto b = pop();                             \
             auto a = pop();                             \
                                                         \
@@ -88,14 +253,23 @@ auto VM::run() -> InterpreterResult {
                 RUNTIME_ERROR("Expect two numbers.");   \
             }                                           \
                                                         \
-            push(a.asNumber() op b.asNumber());         \
+            push(operation(a, b));                      \
+        } while(0)
+
+    // Operands are proven numbers by the compiler, nothing to check.
+    #define NUMERIC_OPERATION(operation) do {           \
+            const Value& b = peek();                    \
+            Value& a = peek(1);                         \
+                                                        \
+            a = operation(a, b);                        \
+            stackTop_--;                                \
         } while(0)
 
     Byte instruction;
-    while(frame->ip < frame->function->chunk.size()){
+    while(frame->ip < frame->chunk->size()){
 
 #ifdef DEBUG
-        disassembler.disassembleInstruction(frame->function->chunk, frame->ip);
+        disassembler.disassembleInstruction(*frame->chunk, frame->ip);
         std::cout << "    ";
         for(Value* it = stack_; it < stackTop_; it++){
             std::cout << '[' << *it << "] ";
@@ -104,6 +278,11 @@ auto VM::run() -> InterpreterResult {
         std::cout << '\n';
 #endif
 
+        if constexpr(Mode == RunMode::Metered){
+            if(fuel_ == 0) return InterpreterResult::RuntimeError;
+            fuel_--;
+        }
+
         instruction = readByte();
         switch(instruction){
             case OpCode::PushConstant:
@@ -117,7 +296,7 @@ auto VM::run() -> InterpreterResult {
                 auto a = pop();
 
                 if(a.isNumber() && b.isNumber()){
-                    push(a.asNumber() + b.asNumber());
+                    push(addNumbers(a, b));
                 } else if(a.isString() && b.isString()){
                     push(a.asString() + b.asString());
                 } else {
@@ -127,19 +306,19 @@ auto VM::run() -> InterpreterResult {
                 break;
             }
             case OpCode::Sub:
-                BINARY_OPERATION(-);
+                BINARY_OPERATION(subtractNumbers);
                 break;
             case OpCode::Div:
-                BINARY_OPERATION(/);
+                BINARY_OPERATION(divideNumbers);
                 break;
             case OpCode::Mult:
-                BINARY_OPERATION(*);
+                BINARY_OPERATION(multiplyNumbers);
                 break;
             case OpCode::Less:
-                BINARY_OPERATION(<);
+                BINARY_OPERATION(lessNumbers);
                 break;
             case OpCode::Greater:
-                BINARY_OPERATION(>);
+                BINARY_OPERATION(greaterNumbers);
                 break;
             case OpCode::Equal:
                 push(pop() == pop());
@@ -152,7 +331,7 @@ auto VM::run() -> InterpreterResult {
                     RUNTIME_ERROR("Expect two numbers.");
                 }
 
-                push(std::pow(base.asNumber(), exponent.asNumber()));
+                push(powerNumbers(base, exponent));
                 break;
             }
             case OpCode::Not:
@@ -160,24 +339,39 @@ auto VM::run() -> InterpreterResult {
                 break;
             case OpCode::Negate:
                 if(peek().isNumber()){
-                    push(-pop().asNumber());
+                    peek() = negateNumber(peek());
                 } else {
                     RUNTIME_ERROR("Expect a number.");
                 }
                 
                 break;
             case OpCode::Print:
+                if constexpr(Mode == RunMode::Metered) return InterpreterResult::RuntimeError;
+
                 std::cout << pop() << '\n';
                 break;
             case OpCode::JumpIfFalse: {
                 std::uint16_t offset = READ_SHORT();
 
+                if constexpr(Mode == RunMode::Profiled) recordBranch(*frame);
+
                 if(peek().isFalsey()) {
                    frame->ip += offset;
                 }
 
                 break;
             }
+            case OpCode::JumpIfTrue: {
+                std::uint16_t offset = READ_SHORT();
+
+                if constexpr(Mode == RunMode::Profiled) recordBranch(*frame);
+
+                if(!peek().isFalsey()) {
+                   frame->ip += offset;
+                }
+
+                break;
+            }
             case OpCode::Jump: {
                 std::uint16_t offset = READ_SHORT();
                 frame->ip += offset;
@@ -189,6 +383,8 @@ auto VM::run() -> InterpreterResult {
                 break;
             }
             case OpCode::DefineGlobal: {
+                if constexpr(Mode == RunMode::Metered) return InterpreterResult::RuntimeError;
+
                 auto& name = READ_CONSTANT().asString();
 
                 if(globals_.find(name) != globals_.end()){
@@ -209,6 +405,8 @@ auto VM::run() -> InterpreterResult {
                 break;
             }
             case OpCode::SetGlobal: {
+                if constexpr(Mode == RunMode::Metered) return InterpreterResult::RuntimeError;
+
                 auto& name = READ_CONSTANT().asString();
 
                 if(globals_.find(name) == globals_.end()){
@@ -244,12 +442,19 @@ auto VM::run() -> InterpreterResult {
                 auto returnValue = pop();
                 frameCount_--;
 
+                if(frame->memoized){
+                    frame->function->memo->insert(std::move(memoKeys_.back()), returnValue);
+                    memoKeys_.pop_back();
+                }
+
+                stackTop_ = frame->slots;
+
+                // The result of the outermost call is left in its callee slot.
                 if(frameCount_ == 0){
-                    pop();
+                    *stackTop_ = std::move(returnValue);
                     return InterpreterResult::Success;
                 }
 
-                stackTop_ = frame->slots;
                 push(std::move(returnValue));
 
                 frame = &frames_[frameCount_ - 1];
@@ -264,6 +469,116 @@ auto VM::run() -> InterpreterResult {
             case OpCode::Nil:
                 push({});
                 break;
+            case OpCode::Dup:
+                push(peek());
+                break;
+            case OpCode::IncrLocal: {
+                Value& local = frame->slots[readByte()];
+                const Value& step = READ_CONSTANT();
+
+                if(!local.isNumber()){
+                    RUNTIME_ERROR("Expect two numbers or two strings.");
+                }
+
+                local = addNumbers(local, step);
+                break;
+            }
+            case OpCode::DecrLocal: {
+                Value& local = frame->slots[readByte()];
+                const Value& step = READ_CONSTANT();
+
+                if(!local.isNumber()){
+                    RUNTIME_ERROR("Expect two numbers.");
+                }
+
+                local = subtractNumbers(local, step);
+                break;
+            }
+            case OpCode::AddNum:
+                NUMERIC_OPERATION(addNumbers);
+                break;
+            case OpCode::SubNum:
+                NUMERIC_OPERATION(subtractNumbers);
+                break;
+            case OpCode::MultNum:
+                NUMERIC_OPERATION(multiplyNumbers);
+                break;
+            case OpCode::DivNum:
+                NUMERIC_OPERATION(divideNumbers);
+                break;
+            case OpCode::LessNum:
+                NUMERIC_OPERATION(lessNumbers);
+                break;
+            case OpCode::GreaterNum:
+                NUMERIC_OPERATION(greaterNumbers);
+                break;
+            case OpCode::CheckType: {
+                const char* error = typeError(peek(), readByte());
+
+                if(error != nullptr){
+                    RUNTIME_ERROR("%s", error);
+                }
+
+                break;
+            }
+            case OpCode::CheckLocal: {
+                const Value& local = frame->slots[readByte()];
+                const char* error = typeError(local, readByte());
+
+                if(error != nullptr){
+                    RUNTIME_ERROR("%s", error);
+                }
+
+                break;
+            }
+            case OpCode::ForPrep: {
+                // Slots hold the counter, the limit and the step, the loop
+                // variable is pushed on top of them.
+                Value* control = &frame->slots[readByte()];
+                const std::uint16_t offset = READ_SHORT();
+
+                if(!control[0].isNumber() || !control[1].isNumber() || !control[2].isNumber()){
+                    RUNTIME_ERROR("Expect numbers for 'for' start, limit and step.");
+                }
+
+                if(control[2].asNumber() == 0){
+                    RUNTIME_ERROR("Expect a non-zero 'for' step.");
+                }
+
+                push(control[0]);
+
+                if(!forContinues(control[0], control[1], control[2])){
+                    frame->ip += offset;
+                }
+
+                break;
+            }
+            case OpCode::ForLoop: {
+                Value* control = &frame->slots[readByte()];
+                const std::uint16_t offset = READ_SHORT();
+
+                // An integer counter that overflows has passed any integer
+                // limit, stop instead of continuing in double.
+                std::int64_t next;
+                if(control[0].isInteger() && control[2].isInteger() &&
+                   __builtin_add_overflow(control[0].asInteger(), control[2].asInteger(), &next)){
+                    break;
+                }
+
+                control[0] = addNumbers(control[0], control[2]);
+
+                if(forContinues(control[0], control[1], control[2])){
+                    control[3] = control[0];
+                    frame->ip -= offset;
+                }
+
+                break;
+            }
+            case OpCode::JumpTable: {
+                const CaseTable& table = frame->chunk->getCaseTable(readByte());
+                frame->ip += jumpTableOffset(table, pop());
+                break;
+            }
             default:
                 RUNTIME_ERROR("Unknow operation.");
         }
@@ -271,6 +586,7 @@ auto VM::run() -> InterpreterResult {
 
     #undef READ_CONSTANT
     #undef READ_SHORT
+    #undef NUMERIC_OPERATION
 
     resetStack();
 
@@ -280,6 +596,7 @@ auto VM::run() -> InterpreterResult {
 auto VM::resetStack() -> void {
     frameCount_ = 0;
     stackTop_ = stack_;
+    memoKeys_.clear();
 }
 
 }